@@ -25,6 +25,10 @@
 #include <string>
 #include <vector>
 #include <iterator>
+#if defined(__cpp_impl_three_way_comparison) && __cpp_impl_three_way_comparison >= 201907L
+#include <compare>
+#define CUDA_UINT128_HAS_SPACESHIP 1
+#endif
 
 #ifdef __has_builtin
 # define uint128_t_has_builtin(x) __has_builtin(x)
@@ -36,6 +40,166 @@
 #define CUDA_UINT128_API __host__ __device__
 #else
 #define CUDA_UINT128_API
+#endif
+
+                      //////////////////////////
+                      //   instrumentation
+                      //////////////////////////
+
+// Defining CUDA_UINT128_INSTRUMENT before including this header counts how
+// often the slow paths of the operations below are taken.  Host threads each
+// bump their own counters, which are summed on snapshot(); device code adds
+// to counters in global memory with atomics (one set per translation unit).
+// Without the define, CUDA_UINT128_COUNT expands to nothing and snapshot()
+// returns zeros.
+
+#ifdef CUDA_UINT128_INSTRUMENT
+#include <atomic>
+#include <mutex>
+#ifdef __CUDACC__
+static __device__ unsigned long long uint128_stats_device[32];
+#endif
+#endif
+
+struct uint128_stats {
+  enum counter {
+    div128to64_calls,
+    div128to64_overflow,     // x.hi >= v, quotient does not fit
+    div128to64_again1,       // correction steps for the high quotient digit
+    div128to64_again2,       // correction steps for the low quotient digit
+    div128to128_wide,        // 128 bit divisors
+    isqrt_calls,
+    isqrt_out_of_range,      // x == 0 or x.hi > 2^60, returns 0
+    icbrt_calls,
+    icbrt_iterations,
+    egcd_full_steps,         // Lehmer steps that fell back to a full division
+    float_to_u128_log2,      // float/double -> uint128_t through log2
+    u128_to_float_wide,      // uint128_t -> float/double with x.hi != 0
+    num_counters
+  };
+#if defined(CUDA_UINT128_INSTRUMENT) && defined(__CUDACC__)
+  static_assert(num_counters <= 32, "uint128_stats_device is too small");
+#endif
+
+  struct counters {
+    uint64_t value[num_counters];
+    uint64_t operator[](counter c) const {return value[c];}
+  };
+
+  static const char * name(counter c)
+  {
+    static const char * names[num_counters] = {
+      "div128to64_calls", "div128to64_overflow", "div128to64_again1",
+      "div128to64_again2", "div128to128_wide", "isqrt_calls",
+      "isqrt_out_of_range", "icbrt_calls", "icbrt_iterations",
+      "egcd_full_steps", "float_to_u128_log2", "u128_to_float_wide"
+    };
+    return names[c];
+  }
+
+#ifndef CUDA_UINT128_INSTRUMENT
+  static counters snapshot(){counters res = {}; return res;}
+  static void reset(){}
+#else
+  /// Totals over all host threads (and, when built with nvcc, the device)
+  static counters snapshot()
+  {
+    counters res = {};
+    registry & reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for(int c = 0; c < num_counters; c++){
+      res.value[c] = reg.retired[c];
+      for(size_t t = 0; t < reg.live.size(); t++)
+        res.value[c] += reg.live[t]->value[c].load(std::memory_order_relaxed);
+    }
+  #ifdef __CUDACC__
+    unsigned long long dev[num_counters];
+    if(cudaMemcpyFromSymbol(dev, uint128_stats_device, sizeof(dev)) == cudaSuccess)
+      for(int c = 0; c < num_counters; c++) res.value[c] += dev[c];
+  #endif
+    return res;
+  }
+
+  /// Zeroes every counter.  Increments racing with a reset may be lost.
+  static void reset()
+  {
+    registry & reg = get_registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for(int c = 0; c < num_counters; c++){
+      reg.retired[c] = 0;
+      for(size_t t = 0; t < reg.live.size(); t++)
+        reg.live[t]->value[c].store(0, std::memory_order_relaxed);
+    }
+  #ifdef __CUDACC__
+    unsigned long long dev[num_counters] = {};
+    cudaMemcpyToSymbol(uint128_stats_device, dev, sizeof(dev));
+  #endif
+  }
+
+  CUDA_UINT128_API static inline void add(counter c, uint64_t n)
+  {
+  #ifdef __CUDA_ARCH__
+    atomicAdd(&uint128_stats_device[c], (unsigned long long) n);
+  #else
+    // only this thread writes its block, so no read-modify-write is needed
+    std::atomic<uint64_t> & v = local().value[c];
+    v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  #endif
+  }
+
+private :
+  struct block {
+    std::atomic<uint64_t> value[num_counters];
+  };
+
+  struct registry {
+    std::mutex mutex;
+    std::vector<block *> live;
+    uint64_t retired[num_counters];
+  };
+
+  static registry & get_registry()
+  {
+    static registry reg;
+    return reg;
+  }
+
+  // Registers the calling thread's block on first use and folds it into the
+  // retired totals when the thread exits.
+  struct thread_block {
+    block b;
+    thread_block()
+    {
+      for(int c = 0; c < num_counters; c++) b.value[c].store(0);
+      registry & reg = get_registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      reg.live.push_back(&b);
+    }
+    ~thread_block()
+    {
+      registry & reg = get_registry();
+      std::lock_guard<std::mutex> lock(reg.mutex);
+      for(int c = 0; c < num_counters; c++) reg.retired[c] += b.value[c].load();
+      for(size_t t = 0; t < reg.live.size(); t++)
+        if(reg.live[t] == &b){
+          reg.live.erase(reg.live.begin() + t);
+          break;
+        }
+    }
+  };
+
+  static block & local()
+  {
+    static thread_local thread_block tb;
+    return tb.b;
+  }
+#endif
+};
+
+#ifdef CUDA_UINT128_INSTRUMENT
+#define CUDA_UINT128_COUNT(c, n) uint128_stats::add(uint128_stats::c, n)
+#else
+#define CUDA_UINT128_COUNT(c, n) ((void) 0)
 #endif
 
 class uint128_t {
@@ -109,7 +273,7 @@ public :
   #elif __x86_64__
     asm(  "add    %q2, %q0\n\t"
           "adc    %q3, %q1\n\t"
-          : "+r" (lo), "+r" (hi)
+          : "+&r" (lo), "+r" (hi)
           : "r" (temp.lo), "r" (temp.hi)
           : "cc");
     return *this;
@@ -132,12 +296,14 @@ public :
     uint128_t temp = (uint128_t)b;
     if(lo < temp.lo) hi--;
     lo -= temp.lo;
+    hi -= temp.hi;
     return * this;
   }
 
   template <typename T>
   CUDA_UINT128_API inline uint128_t & operator>>=(const T & b)
   {
+    if (b == 0) return *this; // a shift by 64 below is undefined
     if (b < 64) {
       lo = (lo >> b) | (hi << (64-b));
       hi >>= b;
@@ -151,6 +317,7 @@ public :
   template <typename T>
   CUDA_UINT128_API inline uint128_t & operator<<=(const T & b)
   {
+    if (b == 0) return *this; // a shift by 64 below is undefined
     if (b < 64) {
       hi = (hi << b) | (lo >> (64-b));
       lo <<= b;
@@ -199,6 +366,9 @@ public :
   CUDA_UINT128_API bool operator>=(uint128_t b){return isGreaterThanOrEqual(*this, b);}
   CUDA_UINT128_API bool operator==(uint128_t b) const {return isEqualTo(*this, b);}
   CUDA_UINT128_API bool operator!=(uint128_t b) const {return isNotEqualTo(*this, b);}
+#ifdef CUDA_UINT128_HAS_SPACESHIP
+  CUDA_UINT128_API std::strong_ordering operator<=>(uint128_t b) const {return compare128(*this, b) <=> 0;}
+#endif
 
   template <typename T>
   CUDA_UINT128_API uint128_t operator|(const T & b) const {return bitwiseOr(*this, (uint128_t)b);}
@@ -270,6 +440,13 @@ public :
     else return 0;
   }
 
+  /// Three-way compare without branches: -1, 0 or 1 as a <, ==, > b
+  CUDA_UINT128_API static inline int compare128(uint128_t a, uint128_t b)
+  {
+    int c = 2 * ((a.hi > b.hi) - (a.hi < b.hi)) + ((a.lo > b.lo) - (a.lo < b.lo));
+    return (c > 0) - (c < 0);
+  }
+
   CUDA_UINT128_API friend uint128_t min(uint128_t a, uint128_t b)
   {
     return a < b ? a : b;
@@ -314,6 +491,56 @@ public :
     return res;
   }
 
+  /// This counts trailing zeros for 64 bit unsigned integers.  The result is
+  /// undefined for x == 0.
+  CUDA_UINT128_API static inline int ctz64(uint64_t x)
+  {
+    int res;
+  #ifdef __CUDA_ARCH__
+    res = __ffsll(x) - 1;
+  #elif __GNUC__ || uint128_t_has_builtin(__builtin_ctzll)
+    res = __builtin_ctzll(x);
+  #elif __x86_64__
+    uint64_t tmp;
+    asm("bsf %1, %0" : "=r" (tmp) : "rm" (x) : "cc");
+    res = tmp;
+  #elif __aarch64__
+    uint64_t tmp;
+    asm("rbit %0, %1\n\tclz %0, %0" : "=r" (tmp) : "r" (x));
+    res = tmp;
+  #else
+  # error Architecture not supported
+  #endif
+    return res;
+  }
+
+  /// Trailing zero count for uint128_t, the counterpart of clz128
+  CUDA_UINT128_API friend inline uint64_t ctz128(uint128_t x)
+  {
+    uint64_t res;
+
+    res = x.lo != 0 ? ctz64(x.lo) : 64 + ctz64(x.hi);
+
+    return res;
+  }
+
+  /// Number of set bits in a 64 bit unsigned integer
+  CUDA_UINT128_API static inline int popcount64(uint64_t x)
+  {
+    int res;
+  #ifdef __CUDA_ARCH__
+    res = __popcll(x);
+  #elif __GNUC__ || uint128_t_has_builtin(__builtin_popcountll)
+    res = __builtin_popcountll(x);
+  #else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    res = (int) ((x * 0x0101010101010101ull) >> 56);
+  #endif
+    return res;
+  }
+
   CUDA_UINT128_API static uint128_t bitwiseOr(uint128_t a, uint128_t b)
   {
     a.lo |= b.lo;
@@ -359,7 +586,7 @@ public :
   #elif __x86_64__
     asm(  "add    %q2, %q0\n\t"
           "adc    %q3, %q1\n\t"
-          : "+r" (x.lo), "+r" (x.hi)
+          : "+&r" (x.lo), "+r" (x.hi)
           : "r" (y.lo), "r" (y.hi)
           : "cc");
     return x;
@@ -453,11 +680,57 @@ public :
     return res;
   }
 
+  /// Low 128 bits of a 128 by 128 bit product
+  CUDA_UINT128_API static inline uint128_t mul128(uint128_t x, uint128_t y)
+  {
+    uint128_t res = mul128(x.lo, y.lo);
+    res.hi += x.hi * y.lo + x.lo * y.hi;
+    return res;
+  }
+
+  /// x * y + z in one step; the carry out of the low word goes straight into
+  /// the high word instead of through a separate add128.
+  CUDA_UINT128_API static inline uint128_t fma128(uint64_t x, uint64_t y, uint128_t z)
+  {
+    uint128_t res;
+  #ifdef __CUDA_ARCH__
+    asm(  "mad.lo.cc.u64  %0, %2, %3, %4;\n\t"
+          "madc.hi.u64    %1, %2, %3, %5;\n\t"
+          : "=l" (res.lo), "=l" (res.hi)
+          : "l" (x), "l" (y),
+            "l" (z.lo), "l" (z.hi));
+  #elif __x86_64__
+    res.lo = x;
+    asm(  "mulq   %2\n\t"
+          "add    %3, %0\n\t"
+          "adc    %4, %1\n\t"
+          : "+&a" (res.lo), "=&d" (res.hi)
+          : "rm" (y), "rm" (z.lo), "rm" (z.hi)
+          : "cc");
+  #elif __aarch64__
+    asm(  "mul    %0, %2, %3\n\t"
+          "umulh  %1, %2, %3\n\t"
+          "adds   %0, %0, %4\n\t"
+          "adc    %1, %1, %5\n\t"
+          : "=&r" (res.lo), "=&r" (res.hi)
+          : "r" (x), "r" (y),
+            "r" (z.lo), "r" (z.hi)
+          : "cc");
+  #else
+  # error Architecture not supported
+  #endif
+    return res;
+  }
+
   // taken from libdivide's adaptation of this implementation origininally in
   // Hacker's Delight: http://www.hackersdelight.org/hdcodetxt/divDouble.c.txt
   // License permits inclusion here per:
   // http://www.hackersdelight.org/permissions.htm
-  CUDA_UINT128_API static inline uint64_t div128to64(uint128_t x, uint64_t v, uint64_t * r = NULL) // x / v
+  /// x / v for quotients below 2^64.  Otherwise (x.hi >= v, which includes
+  /// v == 0) the quotient and remainder come back as (uint64_t) -1 and, if
+  /// overflow is given, *overflow is set.
+  CUDA_UINT128_API static inline uint64_t div128to64(uint128_t x, uint64_t v, uint64_t * r = NULL,
+                                                     bool * overflow = NULL) // x / v
   {
     const uint64_t b = 1ull << 32;
     uint64_t  un1, un0,
@@ -467,7 +740,10 @@ public :
               rhat;
     int s;
 
+    CUDA_UINT128_COUNT(div128to64_calls, 1);
     if(x.hi >= v){
+      CUDA_UINT128_COUNT(div128to64_overflow, 1);
+      if(overflow != NULL) *overflow = true;
       if( r != NULL) *r = (uint64_t) -1;
       return  (uint64_t) -1;
     }
@@ -479,7 +755,7 @@ public :
       un64 = (x.hi << s) | ((x.lo >> (64 - s)) & (-s >> 31));
       un10 = x.lo << s;
     }else{
-      un64 = x.lo | x.hi;
+      un64 = x.hi;
       un10 = x.lo;
     }
 
@@ -494,6 +770,7 @@ public :
 
   again1:
     if (q1 >= b || q1*vn0 > b*rhat + un1){
+      CUDA_UINT128_COUNT(div128to64_again1, 1);
       q1 -= 1;
       rhat = rhat + vn1;
       if(rhat < b) goto again1;
@@ -505,6 +782,7 @@ public :
      rhat = un21 - q0*vn1;
   again2:
     if(q0 >= b || q0 * vn0 > b*rhat + un0){
+      CUDA_UINT128_COUNT(div128to64_again2, 1);
       q0 = q0 - 1;
       rhat = rhat + vn1;
       if(rhat < b) goto again2;
@@ -524,13 +802,36 @@ public :
 
     return res;
   }
-/*
-  CUDA_UINT128_API static inline uint64_t div128to64(uint128_t x, uint128_t v, uint128_t * r = NULL)
+  // 128 by 128 bit division, following the divlu based udivti3 from Hacker's
+  // Delight: with v normalized, a 128 by 64 bit division by the leading word
+  // of v gives a quotient estimate that is at most one too large.
+  CUDA_UINT128_API static inline uint128_t div128to128(uint128_t x, uint128_t v, uint128_t * r = NULL)
   {
-    if(v.hi == 0) return div128to64(x, v.lo, r->lo);
-    uint64_t res;
+    uint128_t res;
+
+    if(v.hi == 0){
+      uint64_t rem;
+      res = div128to128(x, v.lo, &rem);
+      if(r != NULL) *r = rem;
+      return res;
+    }
+
+    CUDA_UINT128_COUNT(div128to128_wide, 1);
+    int s = clz64(v.hi);
+    uint64_t v1 = (v << s).hi;
+    uint64_t q = div128to64(x >> 1, v1);   // (x >> 1).hi < 2^63 <= v1
+    q = (q >> (63 - s));
+    if(q != 0) q--;
+
+    uint128_t rem = x - mul128(v, q);
+    if(rem >= v){
+      q++;
+      rem = rem - v;
+    }
+    if(r != NULL) *r = rem;
+    res = q;
+    return res;
   }
-*/
   CUDA_UINT128_API static inline uint128_t sub128(uint128_t x, uint128_t y) // x - y
   {
     uint128_t res;
@@ -565,8 +866,11 @@ public :
   {
     uint64_t res0 = 0;
 
-    if(x == 0 || x.hi > 1ull << 60)
+    CUDA_UINT128_COUNT(isqrt_calls, 1);
+    if(x == 0 || x.hi > 1ull << 60){
+      CUDA_UINT128_COUNT(isqrt_out_of_range, 1);
       return 0;
+    }
 
     #ifdef __CUDA_ARCH__
     res0 = sqrtf(u128_to_float(x));
@@ -586,6 +890,9 @@ public :
   {
     uint64_t res0 = 0;
 
+    CUDA_UINT128_COUNT(icbrt_calls, 1);
+    CUDA_UINT128_COUNT(icbrt_iterations, 47);
+
   #ifdef __CUDA_ARCH__
     res0 = cbrtf(u128_to_float(x));
   #else
@@ -613,6 +920,428 @@ public :
     return res0 < res1 ? res0 : res1;
   }
 
+                          //////////////////
+                          //      gcd
+                          //////////////////
+
+  CUDA_UINT128_API static inline uint64_t gcd64(uint64_t a, uint64_t b)
+  {
+    if(a == 0) return b;
+    if(b == 0) return a;
+
+    int shift = ctz64(a | b);
+    a >>= ctz64(a);
+    do{
+      b >>= ctz64(b);
+      if(a > b){uint64_t t = a; a = b; b = t;}
+      b -= a;
+    }while(b != 0);
+
+    return a << shift;
+  }
+
+  /// Stein's binary gcd, dropping to 64 bit words as soon as both operands fit
+  CUDA_UINT128_API static inline uint128_t gcd128(uint128_t a, uint128_t b)
+  {
+    if(a == 0) return b;
+    if(b == 0) return a;
+
+    uint64_t shift = ctz128(a | b);
+    a >>= ctz128(a);
+    do{
+      b >>= ctz128(b);
+      if(a > b){uint128_t t = a; a = b; b = t;}
+      if(b.hi == 0) return (uint128_t) gcd64(a.lo, b.lo) << shift;
+      b = b - a;
+    }while(b != 0);
+
+    return a << shift;
+  }
+
+  /// lcm(a, b) modulo 2^128; lcm128(0, b) == 0
+  CUDA_UINT128_API static inline uint128_t lcm128(uint128_t a, uint128_t b)
+  {
+    if(a == 0 || b == 0) return 0;
+    return mul128(div128to128(a, gcd128(a, b)), b);
+  }
+
+  /// Extended gcd.  Returns g = gcd(a, b) along with the magnitudes of Bezout
+  /// coefficients x and y, which always have opposite signs:
+  ///   g == x * a - y * b  if *x_negative is false
+  ///   g == y * b - x * a  if *x_negative is true
+  /// with x <= max(b / 2g, 1) and y <= max(a / 2g, 1).
+  ///
+  /// The remainder sequence is driven by Lehmer steps on the leading 62 bits
+  /// of a and b, so most quotients come from single word arithmetic and a
+  /// full 128 bit division is only needed when the leading words disagree.
+  CUDA_UINT128_API static inline uint128_t egcd128(uint128_t a, uint128_t b,
+                                                   uint128_t * x, uint128_t * y,
+                                                   bool * x_negative)
+  {
+    if(a < b){
+      uint128_t g = egcd128(b, a, y, x, x_negative);
+      *x_negative = !*x_negative;
+      return g;
+    }
+
+    // |cofactors| of the current pair; the signs alternate with each
+    // Euclidean step, so only the parity of the step count is kept.
+    uint128_t s0 = 1, s1 = 0, t0 = 0, t1 = 1;
+    bool odd = false;
+
+    while(b.hi != 0){
+      int k = 66 - (int) clz64(a.hi); // a >> k has 62 bits
+      int64_t ah = (int64_t) (a >> k).lo, bh = (int64_t) (b >> k).lo;
+      int64_t A = 1, B = 0, C = 0, D = 1;
+      bool steps_odd = false;
+
+      while(bh + C > 0 && bh + D > 0){
+        int64_t q = (ah + A) / (bh + C);
+        if(q != (ah + B) / (bh + D)) break;
+        int64_t T = A - q * C; A = C; C = T;
+        T = B - q * D; B = D; D = T;
+        T = ah - q * bh; ah = bh; bh = T;
+        steps_odd = !steps_odd;
+      }
+
+      if(B == 0){
+        // no agreement on even the first quotient: one full step
+        CUDA_UINT128_COUNT(egcd_full_steps, 1);
+        uint128_t r, q = div128to128(a, b, &r);
+        a = b; b = r;
+        uint128_t t = s0 + mul128(q, s1); s0 = s1; s1 = t;
+        t = t0 + mul128(q, t1); t0 = t1; t1 = t;
+        odd = !odd;
+        continue;
+      }
+
+      // [A B; C D] has entries of alternating sign, so every new value is a
+      // difference of two products (exact modulo 2^128) and every new
+      // cofactor a sum of magnitudes.
+      uint64_t ua = A < 0 ? -A : A, ub = B < 0 ? -B : B,
+               uc = C < 0 ? -C : C, ud = D < 0 ? -D : D;
+      uint128_t na = A > 0 ? mul128(a, ua) - mul128(b, ub) : mul128(b, ub) - mul128(a, ua);
+      uint128_t nb = C > 0 ? mul128(a, uc) - mul128(b, ud) : mul128(b, ud) - mul128(a, uc);
+      a = na; b = nb;
+
+      uint128_t ns = mul128(s0, ua) + mul128(s1, ub);
+      s1 = mul128(s0, uc) + mul128(s1, ud); s0 = ns;
+      uint128_t nt = mul128(t0, ua) + mul128(t1, ub);
+      t1 = mul128(t0, uc) + mul128(t1, ud); t0 = nt;
+      odd = odd != steps_odd;
+    }
+
+    if(b != 0){
+      // single word tail; a may still be a full 128 bit value
+      uint64_t r;
+      uint128_t q = div128to128(a, b.lo, &r);
+      uint128_t t = s0 + mul128(q, s1); s0 = s1; s1 = t;
+      t = t0 + mul128(q, t1); t0 = t1; t1 = t;
+      odd = !odd;
+
+      uint64_t u = b.lo, v = r;
+      while(v != 0){
+        uint64_t q64 = u / v, w = u - q64 * v;
+        u = v; v = w;
+        t = s0 + mul128(s1, q64); s0 = s1; s1 = t;
+        t = t0 + mul128(t1, q64); t0 = t1; t1 = t;
+        odd = !odd;
+      }
+      a = u;
+    }
+
+    *x = s0;
+    *y = t0;
+    *x_negative = odd;
+    return a;
+  }
+
+  /// Inverse of a modulo m, or 0 when gcd(a, m) != 1
+  CUDA_UINT128_API static inline uint128_t modinv128(uint128_t a, uint128_t m)
+  {
+    uint128_t x, y;
+    bool x_negative;
+
+    if(m <= 1) return 0;
+    div128to128(a, m, &a);
+    if(egcd128(a, m, &x, &y, &x_negative) != 1) return 0;
+
+    return x_negative ? m - x : x;
+  }
+
+                          //////////////////////
+                          //  logs and powers
+                          //////////////////////
+
+  /// floor(log2(x)), or -1 for x == 0
+  CUDA_UINT128_API static inline int ilog2_128(uint128_t x)
+  {
+    if(x == 0) return -1;
+    return 127 - (int) clz128(x);
+  }
+
+  /// 10^n for n <= 38, the largest power of ten that fits in 128 bits
+  CUDA_UINT128_API static inline uint128_t pow10_128(unsigned n)
+  {
+    // {lo, hi}
+    static constexpr uint64_t pow10[39][2] = {
+      {0x0000000000000001ull, 0x0000000000000000ull},
+      {0x000000000000000aull, 0x0000000000000000ull},
+      {0x0000000000000064ull, 0x0000000000000000ull},
+      {0x00000000000003e8ull, 0x0000000000000000ull},
+      {0x0000000000002710ull, 0x0000000000000000ull},
+      {0x00000000000186a0ull, 0x0000000000000000ull},
+      {0x00000000000f4240ull, 0x0000000000000000ull},
+      {0x0000000000989680ull, 0x0000000000000000ull},
+      {0x0000000005f5e100ull, 0x0000000000000000ull},
+      {0x000000003b9aca00ull, 0x0000000000000000ull},
+      {0x00000002540be400ull, 0x0000000000000000ull},
+      {0x000000174876e800ull, 0x0000000000000000ull},
+      {0x000000e8d4a51000ull, 0x0000000000000000ull},
+      {0x000009184e72a000ull, 0x0000000000000000ull},
+      {0x00005af3107a4000ull, 0x0000000000000000ull},
+      {0x00038d7ea4c68000ull, 0x0000000000000000ull},
+      {0x002386f26fc10000ull, 0x0000000000000000ull},
+      {0x016345785d8a0000ull, 0x0000000000000000ull},
+      {0x0de0b6b3a7640000ull, 0x0000000000000000ull},
+      {0x8ac7230489e80000ull, 0x0000000000000000ull},
+      {0x6bc75e2d63100000ull, 0x0000000000000005ull},
+      {0x35c9adc5dea00000ull, 0x0000000000000036ull},
+      {0x19e0c9bab2400000ull, 0x000000000000021eull},
+      {0x02c7e14af6800000ull, 0x000000000000152dull},
+      {0x1bcecceda1000000ull, 0x000000000000d3c2ull},
+      {0x161401484a000000ull, 0x0000000000084595ull},
+      {0xdcc80cd2e4000000ull, 0x000000000052b7d2ull},
+      {0x9fd0803ce8000000ull, 0x00000000033b2e3cull},
+      {0x3e25026110000000ull, 0x00000000204fce5eull},
+      {0x6d7217caa0000000ull, 0x00000001431e0faeull},
+      {0x4674edea40000000ull, 0x0000000c9f2c9cd0ull},
+      {0xc0914b2680000000ull, 0x0000007e37be2022ull},
+      {0x85acef8100000000ull, 0x000004ee2d6d415bull},
+      {0x38c15b0a00000000ull, 0x0000314dc6448d93ull},
+      {0x378d8e6400000000ull, 0x0001ed09bead87c0ull},
+      {0x2b878fe800000000ull, 0x0013426172c74d82ull},
+      {0xb34b9f1000000000ull, 0x00c097ce7bc90715ull},
+      {0x00f436a000000000ull, 0x0785ee10d5da46d9ull},
+      {0x098a224000000000ull, 0x4b3b4ca85a86c47aull},
+    };
+    uint128_t res;
+    res.lo = pow10[n][0];
+    res.hi = pow10[n][1];
+    return res;
+  }
+
+  /// floor(log10(x)), or -1 for x == 0.  1233 / 4096 is just below log10(2),
+  /// which estimates the answer from the bit length to within one; a single
+  /// table compare fixes it up.
+  CUDA_UINT128_API static inline int ilog10_128(uint128_t x)
+  {
+    int t = ((ilog2_128(x) + 1) * 1233) >> 12;
+    return t - (int) (x < pow10_128(t));
+  }
+
+  /// Number of decimal digits printed for x (1 for x == 0)
+  CUDA_UINT128_API static inline int digit_count(uint128_t x)
+  {
+    return ilog10_128(x) + 1 + (int) (x == 0);
+  }
+
+  /// base^exp modulo 2^128 by square and multiply.  If overflow is given it
+  /// is set to whether the exact result exceeds 128 bits.
+  CUDA_UINT128_API static inline uint128_t ipow128(uint128_t base, unsigned exp, bool * overflow = NULL)
+  {
+    uint128_t res = 1;
+    bool of = false;
+
+    while(exp != 0){
+      if(exp & 1) res = mul128_overflow(res, base, &of);
+      exp >>= 1;
+      if(exp != 0) base = mul128_overflow(base, base, &of);
+    }
+
+    if(overflow != NULL) *overflow = of;
+    return res;
+  }
+
+                        //////////////////////
+                        //  overflow checks
+                        //////////////////////
+
+  // These return the wrapped result and set *overflow when the exact result
+  // does not fit; *overflow is never cleared, so a chain of operations can be
+  // checked once at the end.  The carry or borrow is read from the flags of
+  // the add/adc (sub/sbb) pair itself rather than recomputed with compares.
+
+  /// x + y modulo 2^128, setting *overflow on a carry out
+  CUDA_UINT128_API static inline uint128_t add128_overflow(uint128_t x, uint128_t y, bool * overflow)
+  {
+  #ifdef __CUDA_ARCH__
+    uint32_t c;
+    asm(  "add.cc.u64    %0, %0, %3;\n\t"
+          "addc.cc.u64   %1, %1, %4;\n\t"
+          "addc.u32      %2, 0, 0;\n\t"
+          : "+l" (x.lo), "+l" (x.hi), "=r" (c)
+          : "l" (y.lo), "l" (y.hi));
+  #elif __x86_64__
+  #ifdef __GCC_ASM_FLAG_OUTPUTS__
+    bool c;
+    asm(  "add    %q3, %q0\n\t"
+          "adc    %q4, %q1\n\t"
+          : "+&r" (x.lo), "+r" (x.hi), "=@ccc" (c)
+          : "r" (y.lo), "r" (y.hi));
+  #else
+    uint8_t c;
+    asm(  "add    %q3, %q0\n\t"
+          "adc    %q4, %q1\n\t"
+          "setc   %b2\n\t"
+          : "+&r" (x.lo), "+r" (x.hi), "=q" (c)
+          : "r" (y.lo), "r" (y.hi)
+          : "cc");
+  #endif
+  #elif __aarch64__
+    uint64_t c;
+    asm(  "adds   %0, %0, %3\n\t"
+          "adcs   %1, %1, %4\n\t"
+          "cset   %2, cs\n\t"
+          : "+&r" (x.lo), "+&r" (x.hi), "=r" (c)
+          : "r" (y.lo), "r" (y.hi)
+          : "cc");
+  #else
+  # error Architecture not supported
+  #endif
+    *overflow |= (c != 0);
+    return x;
+  }
+
+  /// x - y modulo 2^128, setting *overflow if y > x
+  CUDA_UINT128_API static inline uint128_t sub128_overflow(uint128_t x, uint128_t y, bool * overflow)
+  {
+  #ifdef __CUDA_ARCH__
+    uint32_t c;
+    asm(  "sub.cc.u64    %0, %0, %3;\n\t"
+          "subc.cc.u64   %1, %1, %4;\n\t"
+          "subc.u32      %2, 0, 0;\n\t"
+          : "+l" (x.lo), "+l" (x.hi), "=r" (c)
+          : "l" (y.lo), "l" (y.hi));
+  #elif __x86_64__
+  #ifdef __GCC_ASM_FLAG_OUTPUTS__
+    bool c;
+    asm(  "sub    %q3, %q0\n\t"
+          "sbb    %q4, %q1\n\t"
+          : "+&r" (x.lo), "+r" (x.hi), "=@ccc" (c)
+          : "r" (y.lo), "r" (y.hi));
+  #else
+    uint8_t c;
+    asm(  "sub    %q3, %q0\n\t"
+          "sbb    %q4, %q1\n\t"
+          "setc   %b2\n\t"
+          : "+&r" (x.lo), "+r" (x.hi), "=q" (c)
+          : "r" (y.lo), "r" (y.hi)
+          : "cc");
+  #endif
+  #elif __aarch64__
+    // the carry flag is clear after a borrow
+    uint64_t c;
+    asm(  "subs   %0, %0, %3\n\t"
+          "sbcs   %1, %1, %4\n\t"
+          "cset   %2, cc\n\t"
+          : "+&r" (x.lo), "+&r" (x.hi), "=r" (c)
+          : "r" (y.lo), "r" (y.hi)
+          : "cc");
+  #else
+  # error Architecture not supported
+  #endif
+    *overflow |= (c != 0);
+    return x;
+  }
+
+  /// x * y modulo 2^128, setting *overflow if the full product does not fit.
+  /// The checks are or-ed together, so there is no branch on the way.
+  CUDA_UINT128_API static inline uint128_t mul128_overflow(uint128_t x, uint128_t y, bool * overflow)
+  {
+    uint128_t res = mul128(x.lo, y.lo);
+    uint128_t c1 = mul128(x.hi, y.lo), c2 = mul128(x.lo, y.hi);
+    bool of = (x.hi != 0) & (y.hi != 0);
+
+    // at most one of the cross products is non-zero unless of is already set
+    of |= (c1.hi | c2.hi) != 0;
+    res = add128_overflow(res, uint128_t(c1.lo + c2.lo) << 64, &of);
+    *overflow |= of;
+
+    return res;
+  }
+
+  /// x / y and, if r is given, x % y.  Division by zero is the only way to
+  /// overflow; it sets *overflow and gives quotient and remainder 0.
+  CUDA_UINT128_API static inline uint128_t div128_overflow(uint128_t x, uint128_t y, bool * overflow,
+                                                           uint128_t * r = NULL)
+  {
+    bool zero = (y.lo | y.hi) == 0;
+    *overflow |= zero;
+    if(zero){
+      if(r != NULL) *r = 0;
+      return 0;
+    }
+    return div128to128(x, y, r);
+  }
+
+
+                        //////////////////////
+                        //   dot products
+                        //////////////////////
+
+  // The products below are summed into four independent (lo, hi) pairs so
+  // the multiplies of consecutive elements do not wait on each other's carry
+  // chain.  A carry out of lo is folded into hi with a compare, which the
+  // compilers turn into add/adc on the host.
+
+  /// sum of x[i] * y[i] for i < n, modulo 2^128
+  CUDA_UINT128_API static inline uint128_t dot_u64_to_u128(const uint64_t * x, const uint64_t * y, size_t n)
+  {
+    return dot_u64_to_u128_strided(x, 1, y, 1, n);
+  }
+
+  /// sum of x[i * incx] * y[i * incy] for i < n, modulo 2^128
+  CUDA_UINT128_API static inline uint128_t dot_u64_to_u128_strided(const uint64_t * x, size_t incx,
+                                                                   const uint64_t * y, size_t incy,
+                                                                   size_t n)
+  {
+    uint64_t lo0 = 0, lo1 = 0, lo2 = 0, lo3 = 0;
+    uint64_t hi0 = 0, hi1 = 0, hi2 = 0, hi3 = 0;
+    size_t i = 0;
+
+    for(; i + 4 <= n; i += 4){
+      uint128_t p0 = mul128(x[(i + 0) * incx], y[(i + 0) * incy]);
+      uint128_t p1 = mul128(x[(i + 1) * incx], y[(i + 1) * incy]);
+      uint128_t p2 = mul128(x[(i + 2) * incx], y[(i + 2) * incy]);
+      uint128_t p3 = mul128(x[(i + 3) * incx], y[(i + 3) * incy]);
+      lo0 += p0.lo; hi0 += p0.hi + (lo0 < p0.lo);
+      lo1 += p1.lo; hi1 += p1.hi + (lo1 < p1.lo);
+      lo2 += p2.lo; hi2 += p2.hi + (lo2 < p2.lo);
+      lo3 += p3.lo; hi3 += p3.hi + (lo3 < p3.lo);
+    }
+    for(; i < n; i++){
+      uint128_t p = mul128(x[i * incx], y[i * incy]);
+      lo0 += p.lo; hi0 += p.hi + (lo0 < p.lo);
+    }
+
+    uint128_t res;
+    res.lo = lo0 + lo1;
+    res.hi = hi0 + hi1 + (res.lo < lo1);
+    lo2 += lo3;
+    hi2 += hi3 + (lo2 < lo3);
+    res.lo += lo2;
+    res.hi += hi2 + (res.lo < lo2);
+    return res;
+  }
+
+  /// y[i] = sum over j < cols of a[i * lda + j] * x[j] for i < rows, modulo 2^128
+  CUDA_UINT128_API static inline void gemv_u64_to_u128(const uint64_t * a, size_t rows, size_t cols,
+                                                       size_t lda, const uint64_t * x, uint128_t * y)
+  {
+    for(size_t i = 0; i < rows; i++)
+      y[i] = dot_u64_to_u128(a + i * lda, x, cols);
+  }
 
                             /////////////////
                             //  typecasting
@@ -636,6 +1365,7 @@ public :
     #else
     if(x.hi == 0) return (double) x.lo;
     #endif
+    CUDA_UINT128_COUNT(u128_to_float_wide, 1);
     uint64_t r = clz64(x.hi);
     x <<= r;
 
@@ -658,6 +1388,7 @@ public :
     #else
     if(x.hi == 0) return (float) x.lo;
     #endif
+    CUDA_UINT128_COUNT(u128_to_float_wide, 1);
     uint64_t r = clz64(x.hi);
     x <<= r;
 
@@ -678,6 +1409,7 @@ public :
     uint128_t x;
     if(dbl < 1 || dbl > 1e39) return 0;
     else{
+      CUDA_UINT128_COUNT(float_to_u128_log2, 1);
 
   #ifdef __CUDA_ARCH__
       uint32_t shft = __double2uint_rd(log2(dbl));
@@ -701,6 +1433,7 @@ public :
     uint128_t x;
     if(flt < 1 || flt > 1e39) return 0;
     else{
+      CUDA_UINT128_COUNT(float_to_u128_log2, 1);
 
   #ifdef __CUDA_ARCH__
       uint32_t shft = __double2uint_rd(log2(flt));
@@ -763,9 +1496,14 @@ CUDA_UINT128_API inline uint128_t mul128(uint128_t x, uint64_t y)
   return uint128_t::mul128(x, y);
 }
 
-CUDA_UINT128_API inline uint64_t div128to64(uint128_t x, uint64_t v, uint64_t * r = NULL)
+CUDA_UINT128_API inline uint128_t fma128(uint64_t x, uint64_t y, uint128_t z)
+{
+  return uint128_t::fma128(x, y, z);
+}
+
+CUDA_UINT128_API inline uint64_t div128to64(uint128_t x, uint64_t v, uint64_t * r = NULL, bool * overflow = NULL)
 {
-  return uint128_t::div128to64(x, v, r);
+  return uint128_t::div128to64(x, v, r, overflow);
 }
 
 CUDA_UINT128_API inline uint128_t div128to128(uint128_t x, uint64_t v, uint64_t * r = NULL)
@@ -773,6 +1511,21 @@ CUDA_UINT128_API inline uint128_t div128to128(uint128_t x, uint64_t v, uint64_t
   return uint128_t::div128to128(x, v, r);
 }
 
+CUDA_UINT128_API inline uint128_t div128to128(uint128_t x, uint128_t v, uint128_t * r = NULL)
+{
+  return uint128_t::div128to128(x, v, r);
+}
+
+CUDA_UINT128_API inline uint128_t mul128(uint128_t x, uint128_t y)
+{
+  return uint128_t::mul128(x, y);
+}
+
+CUDA_UINT128_API inline int compare128(uint128_t a, uint128_t b)
+{
+  return uint128_t::compare128(a, b);
+}
+
 CUDA_UINT128_API inline uint128_t add128(uint128_t x, uint128_t y)
 {
   return uint128_t::add128(x, y);
@@ -799,4 +1552,86 @@ CUDA_UINT128_API inline uint64_t _isqrt(const uint128_t & x)
   return uint128_t::_isqrt(x);
 }
 
+CUDA_UINT128_API inline uint128_t dot_u64_to_u128(const uint64_t * x, const uint64_t * y, size_t n)
+{
+  return uint128_t::dot_u64_to_u128(x, y, n);
+}
+
+CUDA_UINT128_API inline uint128_t dot_u64_to_u128_strided(const uint64_t * x, size_t incx,
+                                                          const uint64_t * y, size_t incy, size_t n)
+{
+  return uint128_t::dot_u64_to_u128_strided(x, incx, y, incy, n);
+}
+
+CUDA_UINT128_API inline void gemv_u64_to_u128(const uint64_t * a, size_t rows, size_t cols,
+                                              size_t lda, const uint64_t * x, uint128_t * y)
+{
+  uint128_t::gemv_u64_to_u128(a, rows, cols, lda, x, y);
+}
+
+CUDA_UINT128_API inline uint128_t gcd128(uint128_t a, uint128_t b)
+{
+  return uint128_t::gcd128(a, b);
+}
+
+CUDA_UINT128_API inline uint128_t lcm128(uint128_t a, uint128_t b)
+{
+  return uint128_t::lcm128(a, b);
+}
+
+CUDA_UINT128_API inline uint128_t egcd128(uint128_t a, uint128_t b, uint128_t * x, uint128_t * y, bool * x_negative)
+{
+  return uint128_t::egcd128(a, b, x, y, x_negative);
+}
+
+CUDA_UINT128_API inline uint128_t modinv128(uint128_t a, uint128_t m)
+{
+  return uint128_t::modinv128(a, m);
+}
+
+CUDA_UINT128_API inline int ilog2_128(uint128_t x)
+{
+  return uint128_t::ilog2_128(x);
+}
+
+CUDA_UINT128_API inline int ilog10_128(uint128_t x)
+{
+  return uint128_t::ilog10_128(x);
+}
+
+CUDA_UINT128_API inline int digit_count(uint128_t x)
+{
+  return uint128_t::digit_count(x);
+}
+
+CUDA_UINT128_API inline uint128_t pow10_128(unsigned n)
+{
+  return uint128_t::pow10_128(n);
+}
+
+CUDA_UINT128_API inline uint128_t ipow128(uint128_t base, unsigned exp, bool * overflow = NULL)
+{
+  return uint128_t::ipow128(base, exp, overflow);
+}
+
+CUDA_UINT128_API inline uint128_t add128_overflow(uint128_t x, uint128_t y, bool * overflow)
+{
+  return uint128_t::add128_overflow(x, y, overflow);
+}
+
+CUDA_UINT128_API inline uint128_t sub128_overflow(uint128_t x, uint128_t y, bool * overflow)
+{
+  return uint128_t::sub128_overflow(x, y, overflow);
+}
+
+CUDA_UINT128_API inline uint128_t mul128_overflow(uint128_t x, uint128_t y, bool * overflow)
+{
+  return uint128_t::mul128_overflow(x, y, overflow);
+}
+
+CUDA_UINT128_API inline uint128_t div128_overflow(uint128_t x, uint128_t y, bool * overflow, uint128_t * r = NULL)
+{
+  return uint128_t::div128_overflow(x, y, overflow, r);
+}
+
 #endif
@@ -0,0 +1,210 @@
+/*
+
+  Carry-less (GF(2)[x]) multiplication and arithmetic in GF(2^128).
+
+  clmul64 multiplies two 64 bit polynomials over GF(2) into a 128 bit one,
+  using PCLMULQDQ on x86 (when built with -mpclmul or an -march that has
+  it), PMULL on aarch64 with the crypto extension, and a 4 bit table
+  elsewhere, including device code.  The table version looks up secret
+  dependent entries, so it is not constant time.
+
+  Elements of GF(2^128) are polynomials of degree < 128 with bit i of a
+  uint128_t as the coefficient of x^i, reduced modulo x^128 + poly where
+  poly has degree < 64.  The default 0x87 is x^7 + x^2 + x + 1, the GCM
+  polynomial; GHASH itself stores its blocks bit reflected, so GHASH
+  inputs need their bits reversed to match this representation.
+
+*/
+
+#ifndef _UINT128_T_CLMUL_CUDA_H
+#define _UINT128_T_CLMUL_CUDA_H
+
+#include "cuda_uint128.h"
+
+#if !defined(__CUDA_ARCH__) && defined(__x86_64__) && defined(__PCLMUL__)
+#include <wmmintrin.h>
+#define CUDA_UINT128_CLMUL_PCLMUL 1
+#define CUDA_UINT128_CLMUL_HW 1
+#elif !defined(__CUDA_ARCH__) && defined(__aarch64__) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define CUDA_UINT128_CLMUL_PMULL 1
+#define CUDA_UINT128_CLMUL_HW 1
+#endif
+
+/// The GCM reduction polynomial without its x^128 term
+#define GF128_POLY_GCM 0x87ull
+
+/// Carry-less product of two 64 bit polynomials, 4 bits of a at a time.
+/// Entry i of the table is b * i, which can spill 3 bits past the low word.
+CUDA_UINT128_API inline uint128_t clmul64_table(uint64_t a, uint64_t b)
+{
+  uint64_t lo[16], hi[16];
+  lo[0] = 0;
+  hi[0] = 0;
+  lo[1] = b;
+  hi[1] = 0;
+  for(int i = 2; i < 16; i += 2){
+    lo[i] = lo[i / 2] << 1;
+    hi[i] = (hi[i / 2] << 1) | (lo[i / 2] >> 63);
+    lo[i + 1] = lo[i] ^ b;
+    hi[i + 1] = hi[i];
+  }
+
+  uint128_t res;
+  for(int s = 60; s >= 0; s -= 4){
+    res.hi = (res.hi << 4) | (res.lo >> 60);
+    res.lo <<= 4;
+    unsigned n = (a >> s) & 15;
+    res.lo ^= lo[n];
+    res.hi ^= hi[n];
+  }
+  return res;
+}
+
+/// Carry-less product of two 64 bit polynomials
+CUDA_UINT128_API inline uint128_t clmul64(uint64_t a, uint64_t b)
+{
+  uint128_t res;
+#if defined CUDA_UINT128_CLMUL_PCLMUL
+  __m128i p = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long) a), _mm_cvtsi64_si128((long long) b), 0x00);
+  res.lo = (uint64_t) _mm_cvtsi128_si64(p);
+  res.hi = (uint64_t) _mm_cvtsi128_si64(_mm_unpackhi_epi64(p, p));
+#elif defined CUDA_UINT128_CLMUL_PMULL
+  uint64x2_t p = vreinterpretq_u64_p128(vmull_p64((poly64_t) a, (poly64_t) b));
+  res.lo = vgetq_lane_u64(p, 0);
+  res.hi = vgetq_lane_u64(p, 1);
+#else
+  res = clmul64_table(a, b);
+#endif
+  return res;
+}
+
+/// Carry-less product of two 128 bit polynomials: returns the low 128 bits
+/// and stores the high 128 bits in *hi.  Karatsuba, so three clmul64 calls
+/// rather than four.
+CUDA_UINT128_API inline uint128_t clmul128(uint128_t a, uint128_t b, uint128_t * hi)
+{
+  uint128_t lo = clmul64(a.lo, b.lo);
+  uint128_t h = clmul64(a.hi, b.hi);
+  uint128_t mid = clmul64(a.lo ^ a.hi, b.lo ^ b.hi);
+  mid.lo ^= lo.lo ^ h.lo;
+  mid.hi ^= lo.hi ^ h.hi;
+
+  lo.hi ^= mid.lo;
+  h.lo ^= mid.hi;
+  *hi = h;
+  return lo;
+}
+
+/// lo + hi * x^128 reduced modulo x^128 + poly.  hi * x^128 is hi * poly;
+/// the part of that above x^128 has at most 63 bits, so one more product
+/// finishes the job.
+CUDA_UINT128_API inline uint128_t gf128_reduce(uint128_t lo, uint128_t hi, uint64_t poly = GF128_POLY_GCM)
+{
+  uint128_t t0 = clmul64(hi.lo, poly);
+  uint128_t t1 = clmul64(hi.hi, poly);   // times x^64
+  lo.lo ^= t0.lo;
+  lo.hi ^= t0.hi ^ t1.lo;
+  uint128_t t2 = clmul64(t1.hi, poly);
+  lo.lo ^= t2.lo;
+  lo.hi ^= t2.hi;
+  return lo;
+}
+
+/// a * b in GF(2^128) modulo x^128 + poly
+CUDA_UINT128_API inline uint128_t gf128_mul(uint128_t a, uint128_t b, uint64_t poly = GF128_POLY_GCM)
+{
+  uint128_t hi, lo = clmul128(a, b, &hi);
+  return gf128_reduce(lo, hi, poly);
+}
+
+/// Polynomial hash of a stream of 128 bit blocks under the key h, the
+/// GHASH construction: for each block x, y = (y + x) * h.
+///
+/// With a hardware carry-less multiply, update() works on groups of blocks
+/// with precomputed powers of h,
+///   y' = (y + x1) * h^4 + x2 * h^3 + x3 * h^2 + x4 * h,
+/// xoring the unreduced 256 bit products together and reducing once per
+/// group.  Without one, each block is multiplied by h with Shoup's 4 bit
+/// tables for the fixed key, which costs far less than going through
+/// clmul64_table.
+class gf128_hash {
+public :
+  static const int group = 4;
+
+  CUDA_UINT128_API explicit gf128_hash(uint128_t h, uint64_t poly = GF128_POLY_GCM) : y(), poly(poly)
+  {
+    hpow[0] = h;
+    for(int i = 1; i < group; i++)
+      hpow[i] = gf128_mul(hpow[i - 1], h, poly);
+
+    for(uint64_t n = 0; n < 16; n++){
+      mtab[n] = gf128_mul(h, n, poly);
+      rtab[n] = clmul64(n, poly);
+    }
+  }
+
+  CUDA_UINT128_API void update(const uint128_t * x, size_t n)
+  {
+    size_t i = 0;
+#ifdef CUDA_UINT128_CLMUL_HW
+    for(; i + group <= n; i += group){
+      uint128_t lo, hi;
+      lo.lo = lo.hi = hi.lo = hi.hi = 0;
+      for(int j = 0; j < group; j++){
+        uint128_t v = x[i + j];
+        if(j == 0){
+          v.lo ^= y.lo;
+          v.hi ^= y.hi;
+        }
+        uint128_t ph, pl = clmul128(v, hpow[group - 1 - j], &ph);
+        lo.lo ^= pl.lo;
+        lo.hi ^= pl.hi;
+        hi.lo ^= ph.lo;
+        hi.hi ^= ph.hi;
+      }
+      y = gf128_reduce(lo, hi, poly);
+    }
+    for(; i < n; i++){
+      y.lo ^= x[i].lo;
+      y.hi ^= x[i].hi;
+      y = gf128_mul(y, hpow[0], poly);
+    }
+#else
+    for(; i < n; i++){
+      y.lo ^= x[i].lo;
+      y.hi ^= x[i].hi;
+      y = mul_h(y);
+    }
+#endif
+  }
+
+  CUDA_UINT128_API uint128_t digest() const {return y;}
+  CUDA_UINT128_API void reset() {y = uint128_t();}
+
+private :
+  uint128_t hpow[group];   // h, h^2, ..., h^group
+  uint128_t mtab[16];      // h * n
+  uint128_t rtab[16];      // n * x^128, that is n * poly
+  uint128_t y;
+  uint64_t poly;
+
+  // a * h a nibble at a time from the top: shift the product up by x^4,
+  // fold the 4 bits pushed past x^128 back in, and add h times the nibble.
+  CUDA_UINT128_API uint128_t mul_h(uint128_t a) const
+  {
+    uint128_t z;
+    for(int k = 0; k < 2; k++){
+      uint64_t w = k == 0 ? a.hi : a.lo;
+      for(int s = 60; s >= 0; s -= 4){
+        unsigned t = z.hi >> 60, n = (w >> s) & 15;
+        z.hi = (z.hi << 4) | (z.lo >> 60);
+        z.lo = (z.lo << 4) ^ rtab[t].lo ^ mtab[n].lo;
+        z.hi ^= rtab[t].hi ^ mtab[n].hi;
+      }
+    }
+    return z;
+  }
+};
+
+#endif
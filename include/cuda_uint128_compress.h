@@ -0,0 +1,358 @@
+/*
+
+  Compact storage for arrays of uint128_t that are mostly small or sorted.
+
+  - LEB128 varints: 7 bits per byte, so values below 2^64 take at most 10
+    bytes instead of 16.
+  - delta and zigzag delta coding, to turn sorted (or nearly sorted)
+    sequences into small values first.
+  - u128_packed_array, a frame-of-reference bit packing: every block of 256
+    values stores its minimum and the differences from it in just as many
+    bits as the largest difference needs.  Blocks decode independently and
+    single values can be read without decoding anything else.
+
+  The single value varint and zigzag functions also work in device code; the
+  array code is host only.
+
+*/
+
+#ifndef _UINT128_T_COMPRESS_CUDA_H
+#define _UINT128_T_COMPRESS_CUDA_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "cuda_uint128.h"
+
+                        //////////////////////
+                        //     varints
+                        //////////////////////
+
+/// Longest LEB128 encoding of a uint128_t
+#define U128_VARINT_MAX_BYTES 19
+
+/// Writes x as a LEB128 varint and returns the number of bytes used.  out
+/// must have room for U128_VARINT_MAX_BYTES.
+CUDA_UINT128_API inline size_t u128_varint_encode(uint128_t x, uint8_t * out)
+{
+  size_t n = 0;
+  while(x.hi != 0 || x.lo >= 0x80){
+    out[n++] = (uint8_t) (x.lo | 0x80);
+    x >>= 7;
+  }
+  out[n++] = (uint8_t) x.lo;
+  return n;
+}
+
+/// Reads one LEB128 varint from [p, end) into *out and returns the position
+/// after it, or NULL if the input ends inside the varint or the value does
+/// not fit in 128 bits.
+CUDA_UINT128_API inline const uint8_t * u128_varint_decode(const uint8_t * p, const uint8_t * end, uint128_t * out)
+{
+  if(p < end && *p < 0x80){
+    *out = (uint64_t) *p;
+    return p + 1;
+  }
+
+  uint64_t lo = 0, hi = 0;
+  for(int shift = 0; p < end; shift += 7){
+    uint64_t b = *p++ & 0x7f;
+    if(shift < 64){
+      lo |= b << shift;
+      if(shift > 57) hi |= b >> (64 - shift);
+    }else{
+      // the last byte may only hold the top 2 bits
+      if(shift == 126 && b > 3) return NULL;
+      hi |= b << (shift - 64);
+    }
+    if(!(p[-1] & 0x80)){
+      out->lo = lo;
+      out->hi = hi;
+      return p;
+    }
+    if(shift == 126) return NULL;
+  }
+  return NULL;
+}
+
+/// Appends the varints of v[0], ..., v[n - 1] to *out
+inline void u128_varint_encode_array(const uint128_t * v, size_t n, std::vector<uint8_t> * out)
+{
+  size_t used = out->size();
+  out->resize(used + n * U128_VARINT_MAX_BYTES);
+  uint8_t * q = out->data() + used;
+  for(size_t i = 0; i < n; i++)
+    q += u128_varint_encode(v[i], q);
+  out->resize(q - out->data());
+}
+
+/// Decodes n varints from [p, p + size) into out.  Returns the position after
+/// the last one, or NULL if the input is short or malformed.
+inline const uint8_t * u128_varint_decode_array(const uint8_t * p, size_t size, uint128_t * out, size_t n)
+{
+  const uint8_t * end = p + size;
+  for(size_t i = 0; i < n; i++){
+    // one byte values are the common case for small keys
+    if(p < end && *p < 0x80){
+      out[i] = (uint64_t) *p++;
+      continue;
+    }
+    p = u128_varint_decode(p, end, out + i);
+    if(p == NULL) return NULL;
+  }
+  return p;
+}
+
+                        //////////////////////
+                        //  delta and zigzag
+                        //////////////////////
+
+/// Maps differences taken mod 2^128 to small values when they are small in
+/// either direction: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+CUDA_UINT128_API inline uint128_t u128_zigzag_encode(uint128_t d)
+{
+  uint64_t sign = (uint64_t) 0 - (d.hi >> 63);
+  d <<= 1;
+  d.lo ^= sign;
+  d.hi ^= sign;
+  return d;
+}
+
+CUDA_UINT128_API inline uint128_t u128_zigzag_decode(uint128_t z)
+{
+  uint64_t sign = (uint64_t) 0 - (z.lo & 1);
+  z >>= 1;
+  z.lo ^= sign;
+  z.hi ^= sign;
+  return z;
+}
+
+/// out[i] = in[i] - in[i - 1], with in[-1] taken as prev.  Differences wrap
+/// mod 2^128, so this is lossless for any input; in and out may be the same.
+inline void u128_delta_encode(const uint128_t * in, size_t n, uint128_t * out, uint128_t prev = 0)
+{
+  for(size_t i = 0; i < n; i++){
+    uint128_t x = in[i];
+    out[i] = x - prev;
+    prev = x;
+  }
+}
+
+/// Inverse of u128_delta_encode: a running sum starting from prev
+inline void u128_delta_decode(const uint128_t * in, size_t n, uint128_t * out, uint128_t prev = 0)
+{
+  for(size_t i = 0; i < n; i++){
+    prev += in[i];
+    out[i] = prev;
+  }
+}
+
+/// Delta coding for sequences that are only mostly sorted: each difference
+/// is zigzag encoded, so small steps down stay small too.
+inline void u128_zigzag_delta_encode(const uint128_t * in, size_t n, uint128_t * out, uint128_t prev = 0)
+{
+  for(size_t i = 0; i < n; i++){
+    uint128_t x = in[i];
+    out[i] = u128_zigzag_encode(x - prev);
+    prev = x;
+  }
+}
+
+inline void u128_zigzag_delta_decode(const uint128_t * in, size_t n, uint128_t * out, uint128_t prev = 0)
+{
+  for(size_t i = 0; i < n; i++){
+    prev += u128_zigzag_decode(in[i]);
+    out[i] = prev;
+  }
+}
+
+                        //////////////////////
+                        //   bit packing
+                        //////////////////////
+
+/// Frame-of-reference bit packing of a uint128_t array in blocks of 256.
+///
+/// Within a block, value j is stored as its difference from the block
+/// minimum, in w bits where w = 128 - clz128(max - min).  The low
+/// min(w, 64) bits of the differences are packed first, then the remaining
+/// w - 64 high bits if there are any, so a block takes exactly 4 * w words.
+/// Each part is split over 4 interleaved lanes of 64 bit words (value j goes
+/// to lane j % 4), which makes every step of the unpacking loop the same
+/// shift and mask on 4 adjacent words, a loop compilers turn into vector
+/// instructions.
+class u128_packed_array {
+public :
+  static const size_t block_size = 256;
+
+  u128_packed_array() : count(0) { }
+
+  u128_packed_array(const uint128_t * v, size_t n) : count(0) {assign(v, n);}
+
+  void assign(const uint128_t * v, size_t n)
+  {
+    count = n;
+    head.clear();
+    words.clear();
+    uint64_t delta[2][block_size];
+
+    for(size_t first = 0; first < n; first += block_size){
+      size_t m = n - first < block_size ? n - first : block_size;
+      const uint128_t * b = v + first;
+
+      block_info h;
+      h.base = b[0];
+      uint128_t top = b[0];
+      for(size_t j = 1; j < m; j++){
+        if(b[j] < h.base) h.base = b[j];
+        if(b[j] > top) top = b[j];
+      }
+      top = top - h.base;
+      h.width = top == 0 ? 0 : 128 - (uint32_t) clz128(top);
+      h.offset = words.size();
+      head.push_back(h);
+
+      // a short last block is padded with copies of the minimum
+      for(size_t j = 0; j < block_size; j++){
+        uint128_t d = j < m ? b[j] - h.base : uint128_t(0);
+        delta[0][j] = d.lo;
+        delta[1][j] = d.hi;
+      }
+      words.resize(words.size() + 4 * (size_t) h.width);
+      uint64_t * w = words.data() + h.offset;
+      pack(delta[0], lo_width(h.width), w);
+      pack(delta[1], hi_width(h.width), w + 4 * lo_width(h.width));
+    }
+  }
+
+  size_t size() const {return count;}
+  size_t blocks() const {return head.size();}
+
+  /// Bytes of packed data and block headers
+  size_t bytes() const {return words.size() * sizeof(uint64_t) + head.size() * sizeof(block_info);}
+
+  /// Bits per value used by block b
+  uint32_t width(size_t b) const {return head[b].width;}
+
+  /// Value i, read straight out of the packed words
+  uint128_t operator[](size_t i) const
+  {
+    const block_info & h = head[i / block_size];
+    const uint64_t * w = words.data() + h.offset;
+    size_t j = i % block_size, lane = j & 3, row = j >> 2;
+    uint32_t lw = lo_width(h.width);
+
+    uint128_t d = extract(w, lw, lane, row);
+    if(h.width > 64)
+      d.hi = extract(w + 4 * lw, h.width - 64, lane, row).lo;
+    return h.base + d;
+  }
+
+  /// Decodes block b into out, which must hold block_size values; returns
+  /// the number of values in the block.
+  size_t decode_block(size_t b, uint128_t * out) const
+  {
+    const block_info & h = head[b];
+    const uint64_t * w = words.data() + h.offset;
+    uint64_t lo[block_size], hi[block_size];
+    uint32_t lw = lo_width(h.width);
+
+    unpack(w, lw, lo);
+    // add the base with a carry from the low word
+    if(h.width > 64){
+      unpack(w + 4 * lw, h.width - 64, hi);
+      for(size_t j = 0; j < block_size; j++){
+        uint64_t l = lo[j] + h.base.lo;
+        out[j].lo = l;
+        out[j].hi = hi[j] + h.base.hi + (l < lo[j]);
+      }
+    }else{
+      for(size_t j = 0; j < block_size; j++){
+        uint64_t l = lo[j] + h.base.lo;
+        out[j].lo = l;
+        out[j].hi = h.base.hi + (l < lo[j]);
+      }
+    }
+    size_t left = count - b * block_size;
+    return left < block_size ? left : block_size;
+  }
+
+  /// Decodes everything into out[0], ..., out[size() - 1]; blocks are spread
+  /// across threads when OpenMP is enabled.
+  void decode(uint128_t * out) const
+  {
+    const int64_t nb = (int64_t) head.size();
+    const int64_t full = count % block_size == 0 ? nb : nb - 1;
+
+    #pragma omp parallel for schedule(static)
+    for(int64_t b = 0; b < full; b++)
+      decode_block((size_t) b, out + b * block_size);
+
+    if(full < nb){
+      uint128_t tmp[block_size];
+      size_t m = decode_block((size_t) full, tmp);
+      std::copy(tmp, tmp + m, out + full * block_size);
+    }
+  }
+
+private :
+  struct block_info {
+    uint128_t base;
+    uint64_t offset;    // into words
+    uint32_t width;
+  };
+
+  size_t count;
+  std::vector<block_info> head;
+  std::vector<uint64_t> words;
+
+  static uint32_t lo_width(uint32_t w) {return w < 64 ? w : 64;}
+  static uint32_t hi_width(uint32_t w) {return w > 64 ? w - 64 : 0;}
+
+  // Lane l holds values l, l + 4, l + 8, ... as a plain bit stream of
+  // 64 * w bits; word k of lane l is out[4 * k + l].
+  static void pack(const uint64_t * v, uint32_t w, uint64_t * out)
+  {
+    if(w == 0) return;
+    std::memset(out, 0, 4 * w * sizeof(uint64_t));
+    for(size_t row = 0; row < block_size / 4; row++){
+      size_t pos = row * w, k = pos >> 6, sh = pos & 63;
+      for(size_t l = 0; l < 4; l++){
+        uint64_t x = v[4 * row + l];
+        out[4 * k + l] |= x << sh;
+        if(sh + w > 64) out[4 * (k + 1) + l] |= x >> (64 - sh);
+      }
+    }
+  }
+
+  static void unpack(const uint64_t * in, uint32_t w, uint64_t * v)
+  {
+    if(w == 0){
+      std::memset(v, 0, block_size * sizeof(uint64_t));
+      return;
+    }
+    const uint64_t mask = w == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << w) - 1;
+    for(size_t row = 0; row < block_size / 4; row++){
+      size_t pos = row * w, k = pos >> 6, sh = pos & 63;
+      const uint64_t * p = in + 4 * k;
+      if(sh + w > 64){
+        for(size_t l = 0; l < 4; l++)
+          v[4 * row + l] = ((p[l] >> sh) | (p[l + 4] << (64 - sh))) & mask;
+      }else{
+        for(size_t l = 0; l < 4; l++)
+          v[4 * row + l] = (p[l] >> sh) & mask;
+      }
+    }
+  }
+
+  static uint128_t extract(const uint64_t * in, uint32_t w, size_t lane, size_t row)
+  {
+    if(w == 0) return 0;
+    size_t pos = row * w, k = pos >> 6, sh = pos & 63;
+    uint64_t x = in[4 * k + lane] >> sh;
+    if(sh + w > 64) x |= in[4 * (k + 1) + lane] << (64 - sh);
+    return w == 64 ? x : x & (((uint64_t) 1 << w) - 1);
+  }
+};
+
+#endif
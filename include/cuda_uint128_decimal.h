@@ -0,0 +1,435 @@
+/*
+
+  Fixed-point decimal numbers stored as a uint128_t count of units of
+  10^-Scale, for up to 38 significant digits of exact (unsigned) decimal
+  arithmetic.  The scale is a template parameter, so every power of ten used
+  for rescaling is known at compile time together with its reciprocal, and
+  multiplying or rescaling never executes a hardware divide: the quotient by
+  10^k is computed with the invariant-divisor method of Moller and Granlund,
+  "Improved division by invariant integers" (2011).
+
+  Arithmetic is usable on the device; text conversion is host only.
+
+*/
+
+#ifndef _UINT128_T_DECIMAL_CUDA_H
+#define _UINT128_T_DECIMAL_CUDA_H
+
+#include "cuda_uint128.h"
+
+enum decimal128_rounding {
+  round_down,       // toward zero (truncate)
+  round_up,         // away from zero
+  round_half_up,    // to nearest, ties away from zero
+  round_half_even   // to nearest, ties to even (banker's rounding)
+};
+
+/// 10^K along with what is needed to divide by it without a divide
+/// instruction: the shift that normalizes it and the reciprocal
+/// floor((2^128 - 1) / (10^K << shift)) - 2^64.
+template <unsigned K>
+struct decimal128_pow10 {
+  static_assert(K <= 19, "10^K must fit in 64 bits");
+
+  static constexpr uint64_t pow(unsigned k) {return k == 0 ? 1 : 10 * pow(k - 1);}
+  static constexpr int nlz(uint64_t x, int n = 0) {return x >> 63 ? n : nlz(x << 1, n + 1);}
+
+  // restoring division of (~d, ~0) by d, one quotient bit at a time
+  static constexpr uint64_t reciprocal(uint64_t d)
+  {
+    uint64_t r = ~d, q = 0;
+    for(int i = 63; i >= 0; i--){
+      bool carry = r >> 63;
+      r = (r << 1) | 1;
+      q <<= 1;
+      if(carry || r >= d){
+        r -= d;
+        q |= 1;
+      }
+    }
+    return q;
+  }
+
+  static constexpr uint64_t value = pow(K);
+  static constexpr int shift = nlz(value);
+  static constexpr uint64_t norm = value << shift;
+  static constexpr uint64_t inv = reciprocal(norm);
+};
+
+/// Limb level helpers shared by the decimal128 operations
+struct decimal128_detail {
+  /// 128 x 128 -> 256 bit product, least significant limb first
+  CUDA_UINT128_API static inline void mul256(uint128_t a, uint128_t b, uint64_t * p)
+  {
+    uint128_t p00 = mul128(a.lo, b.lo), p01 = mul128(a.lo, b.hi),
+              p10 = mul128(a.hi, b.lo), p11 = mul128(a.hi, b.hi);
+    uint128_t t = (uint128_t) p00.hi + p01.lo;
+    t = t + p10.lo;
+    p[0] = p00.lo;
+    p[1] = t.lo;
+    t = (uint128_t) p01.hi + p10.hi + t.hi;
+    t = t + p11.lo;
+    p[2] = t.lo;
+    p[3] = p11.hi + t.hi;
+  }
+
+  /// (u1, u0) / d for normalized d and u1 < d, using v = reciprocal(d)
+  CUDA_UINT128_API static inline uint64_t div_preinv(uint64_t u1, uint64_t u0, uint64_t d,
+                                                     uint64_t v, uint64_t * r)
+  {
+    uint128_t q = mul128(v, u1);
+    uint128_t u;
+    u.lo = u0;
+    u.hi = u1;
+    q = q + u;
+    q.hi++;
+
+    uint64_t rem = u0 - q.hi * d;
+    if(rem > q.lo){
+      q.hi--;
+      rem += d;
+    }
+    if(rem >= d){
+      q.hi++;
+      rem -= d;
+    }
+    *r = rem;
+    return q.hi;
+  }
+
+  /// u[0..n) /= 10^K in place, least significant limb first; returns the
+  /// remainder
+  template <unsigned K>
+  CUDA_UINT128_API static inline uint64_t divrem_pow10(uint64_t * u, int n)
+  {
+    typedef decimal128_pow10<K> p;
+    const int s = p::shift;
+    uint64_t r = s == 0 ? 0 : u[n - 1] >> (64 - s);
+
+    for(int i = n - 1; i >= 0; i--){
+      uint64_t next = s == 0 || i == 0 ? 0 : u[i - 1] >> (64 - s);
+      uint64_t limb = (u[i] << s) | next;
+      u[i] = div_preinv(r, limb, p::norm, p::inv, &r);
+    }
+    return r >> s;
+  }
+
+  /// Whether a quotient q with remainder r (r < d) rounds up to q + 1
+  CUDA_UINT128_API static inline bool round_increment(decimal128_rounding mode, bool q_odd,
+                                                      uint128_t r, uint128_t d)
+  {
+    if(r == 0) return false;
+    uint128_t rest = d - r;   // r > rest <=> r > d / 2
+    switch(mode){
+    case round_up:        return true;
+    case round_half_up:   return !(r < rest);
+    case round_half_even: return r > rest || (r == rest && q_odd);
+    default:              return false;
+    }
+  }
+
+  /// (n2, n1, n0) / (d1, d0) for normalized d1 and (n2, n1) < (d1, d0);
+  /// the remainder is left in (n1, n0).  Knuth's algorithm D for one
+  /// quotient limb: the estimate from the top limbs is at most two too large.
+  CUDA_UINT128_API static inline uint64_t div3by2(uint64_t n2, uint64_t * n1, uint64_t * n0,
+                                                  uint64_t d1, uint64_t d0)
+  {
+    uint64_t q;
+    if(n2 >= d1){
+      q = (uint64_t) -1;
+    }else{
+      uint128_t top;
+      top.lo = *n1;
+      top.hi = n2;
+      q = div128to64(top, d1);
+    }
+
+    // (n2, n1, n0) - q * (d1, d0)
+    uint128_t p0 = mul128(q, d0), p1 = mul128(q, d1);
+    uint128_t p = (uint128_t) p0.hi + p1.lo;
+    uint64_t s0 = *n0 - p0.lo;
+    uint64_t b = *n0 < p0.lo;
+    uint64_t s1 = *n1 - p.lo - b;
+    b = *n1 < p.lo || (*n1 == p.lo && b);
+    uint64_t s2 = n2 - p1.hi - p.hi - b;
+
+    while(s2 != 0){ // negative: add the divisor back
+      q--;
+      uint64_t c;
+      s0 += d0;
+      c = s0 < d0;
+      uint64_t t = s1 + c;
+      c = t < c;
+      s1 = t + d1;
+      c += s1 < d1;
+      s2 += c;
+    }
+    *n1 = s1;
+    *n0 = s0;
+    return q;
+  }
+};
+
+template <unsigned Scale>
+class decimal128 {
+  static_assert(Scale <= 19, "decimal128 supports up to 19 fractional digits");
+  typedef decimal128_pow10<Scale> unit;
+
+public :
+  uint128_t raw;  // the value times 10^Scale
+
+  CUDA_UINT128_API decimal128() : raw() { }
+
+  CUDA_UINT128_API static inline decimal128 from_raw(uint128_t r)
+  {
+    decimal128 res;
+    res.raw = r;
+    return res;
+  }
+
+  CUDA_UINT128_API static inline decimal128 from_integer(uint128_t n, bool * overflow = NULL)
+  {
+    uint64_t top;
+    decimal128 res = from_raw(mul128x64(n, unit::value, &top));
+    if(overflow != NULL) *overflow = top != 0;
+    return res;
+  }
+
+  CUDA_UINT128_API inline uint128_t integer_part() const
+  {
+    uint64_t u[2] = {raw.lo, raw.hi};
+    decimal128_detail::divrem_pow10<Scale>(u, 2);
+    uint128_t res;
+    res.lo = u[0];
+    res.hi = u[1];
+    return res;
+  }
+
+  CUDA_UINT128_API inline uint64_t fraction_part() const
+  {
+    uint64_t u[2] = {raw.lo, raw.hi};
+    return decimal128_detail::divrem_pow10<Scale>(u, 2);
+  }
+
+                          //////////////////
+                          //   arithmetic
+                          //////////////////
+
+  // Each operation returns the result modulo 2^128 units and, if overflow is
+  // given, sets it to whether the exact (rounded) result did not fit.
+
+  CUDA_UINT128_API static inline decimal128 add(decimal128 a, decimal128 b, bool * overflow = NULL)
+  {
+    decimal128 res = from_raw(a.raw + b.raw);
+    if(overflow != NULL) *overflow = res.raw < a.raw;
+    return res;
+  }
+
+  CUDA_UINT128_API static inline decimal128 sub(decimal128 a, decimal128 b, bool * overflow = NULL)
+  {
+    if(overflow != NULL) *overflow = a.raw < b.raw;
+    return from_raw(a.raw - b.raw);
+  }
+
+  CUDA_UINT128_API static inline decimal128 mul(decimal128 a, decimal128 b,
+                                                decimal128_rounding mode = round_half_even,
+                                                bool * overflow = NULL)
+  {
+    uint64_t p[4];
+    decimal128_detail::mul256(a.raw, b.raw, p);
+    uint64_t r = decimal128_detail::divrem_pow10<Scale>(p, 4);
+
+    uint128_t q;
+    q.lo = p[0];
+    q.hi = p[1];
+    bool of = p[2] != 0 || p[3] != 0;
+    if(decimal128_detail::round_increment(mode, q.lo & 1, r, unit::value)){
+      q = q + 1;
+      of = of || q == 0;
+    }
+    if(overflow != NULL) *overflow = of;
+    return from_raw(q);
+  }
+
+  /// a / b.  Division by zero reports overflow and returns 0.
+  CUDA_UINT128_API static inline decimal128 div(decimal128 a, decimal128 b,
+                                                decimal128_rounding mode = round_half_even,
+                                                bool * overflow = NULL)
+  {
+    if(b.raw == 0){
+      if(overflow != NULL) *overflow = true;
+      return decimal128();
+    }
+
+    // n = a * 10^Scale, at most 192 bits
+    uint64_t n2;
+    uint128_t n = mul128x64(a.raw, unit::value, &n2);
+    uint128_t q, r;
+    bool of = false;
+
+    if(b.raw.hi == 0){
+      uint64_t rem, d = b.raw.lo;
+      uint128_t top;
+      top.lo = n.hi;
+      top.hi = n2;
+      uint128_t qtop = div128to128(top, d, &rem);  // high limbs of the quotient
+      of = qtop.hi != 0;
+      top.lo = n.lo;
+      top.hi = rem;
+      q.hi = qtop.lo;
+      q.lo = div128to64(top, d, &rem);
+      r = rem;
+    }else{
+      // normalize the divisor, shifting n into four limbs
+      int s = uint128_t::clz64(b.raw.hi);
+      uint128_t d = b.raw << s;
+      uint64_t u0 = n.lo << s;
+      uint64_t u1 = s == 0 ? n.hi : (n.hi << s) | (n.lo >> (64 - s));
+      uint64_t u2 = s == 0 ? n2 : (n2 << s) | (n.hi >> (64 - s));
+      uint64_t u3 = s == 0 ? 0 : n2 >> (64 - s);
+
+      q.hi = decimal128_detail::div3by2(u3, &u2, &u1, d.hi, d.lo);
+      q.lo = decimal128_detail::div3by2(u2, &u1, &u0, d.hi, d.lo);
+      r.lo = u0;
+      r.hi = u1;
+      r >>= s;
+    }
+
+    if(decimal128_detail::round_increment(mode, q.lo & 1, r, b.raw)){
+      q = q + 1;
+      of = of || q == 0;
+    }
+    if(overflow != NULL) *overflow = of;
+    return from_raw(q);
+  }
+
+  /// The same value at another scale, rounding if digits are dropped
+  template <unsigned S2>
+  CUDA_UINT128_API inline decimal128<S2> rescale(decimal128_rounding mode = round_half_even,
+                                                 bool * overflow = NULL) const
+  {
+    const unsigned up = S2 >= Scale ? S2 - Scale : 0;
+    const unsigned down = S2 >= Scale ? 0 : Scale - S2;
+    uint128_t q;
+    bool of = false;
+
+    if(down == 0){
+      uint64_t top;
+      q = mul128x64(raw, decimal128_pow10<up>::value, &top);
+      of = top != 0;
+    }else{
+      uint64_t u[2] = {raw.lo, raw.hi};
+      uint64_t r = decimal128_detail::divrem_pow10<down>(u, 2);
+      q.lo = u[0];
+      q.hi = u[1];
+      if(decimal128_detail::round_increment(mode, q.lo & 1, r, decimal128_pow10<down>::value))
+        q = q + 1;  // q < 2^128 / 10, so this cannot wrap
+    }
+
+    if(overflow != NULL) *overflow = of;
+    return decimal128<S2>::from_raw(q);
+  }
+
+                            //////////////////
+                            //   operators
+                            //////////////////
+
+  CUDA_UINT128_API decimal128 operator+(decimal128 b) const {return add(*this, b);}
+  CUDA_UINT128_API decimal128 operator-(decimal128 b) const {return sub(*this, b);}
+  CUDA_UINT128_API decimal128 operator*(decimal128 b) const {return mul(*this, b);}
+  CUDA_UINT128_API decimal128 operator/(decimal128 b) const {return div(*this, b);}
+
+  CUDA_UINT128_API decimal128 & operator+=(decimal128 b){return *this = *this + b;}
+  CUDA_UINT128_API decimal128 & operator-=(decimal128 b){return *this = *this - b;}
+  CUDA_UINT128_API decimal128 & operator*=(decimal128 b){return *this = *this * b;}
+  CUDA_UINT128_API decimal128 & operator/=(decimal128 b){return *this = *this / b;}
+
+  CUDA_UINT128_API bool operator==(decimal128 b) const {return raw == b.raw;}
+  CUDA_UINT128_API bool operator!=(decimal128 b) const {return raw != b.raw;}
+  CUDA_UINT128_API bool operator<(decimal128 b) const {return raw < b.raw;}
+  CUDA_UINT128_API bool operator>(decimal128 b) const {return raw > b.raw;}
+  CUDA_UINT128_API bool operator<=(decimal128 b) const {return !(raw > b.raw);}
+  CUDA_UINT128_API bool operator>=(decimal128 b) const {return !(raw < b.raw);}
+
+                            /////////////////
+                            //  typecasting
+                            /////////////////
+
+  /// Parses "123", "123." or "123.4567"; fraction digits beyond Scale are
+  /// rounded with the given mode.  Parsing stops at the first character that
+  /// is not part of the number.
+  static inline decimal128 from_string(const std::string & s,
+                                       decimal128_rounding mode = round_half_even,
+                                       bool * overflow = NULL)
+  {
+    bool of = false, of1;
+    uint128_t n;
+    size_t i = 0;
+    for(; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++)
+      n = add128_overflow(mul128_overflow(n, 10, &of), s[i] - '0', &of);
+    decimal128 res = from_integer(n, &of1);
+    of = of || of1;
+
+    if(i < s.size() && s[i] == '.'){
+      std::string frac;
+      i++;
+      for(; i < s.size() && s[i] >= '0' && s[i] <= '9' && frac.size() < Scale; i++)
+        frac += s[i];
+      frac.append(Scale - frac.size(), '0');
+
+      bool of2 = false;
+      uint128_t raw = res.raw + string_to_u128(frac).lo;
+      of = of || raw < res.raw;
+
+      // the first dropped digit and whether anything non-zero follows it
+      // stand in for the remainder
+      if(i < s.size() && s[i] >= '0' && s[i] <= '9'){
+        uint64_t first = s[i] - '0';
+        bool rest = false;
+        for(i++; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++)
+          rest = rest || s[i] != '0';
+        uint128_t r = first * 2 + rest, d = 20;
+        if(decimal128_detail::round_increment(mode, raw.lo & 1, r, d)){
+          raw = raw + 1;
+          of2 = raw == 0;
+        }
+      }
+      res.raw = raw;
+      of = of || of2;
+    }
+
+    if(overflow != NULL) *overflow = of;
+    return res;
+  }
+
+  inline std::string to_string() const
+  {
+    std::string res = u128_to_string(integer_part());
+    if(Scale != 0){
+      std::string frac = u128_to_string(fraction_part());
+      res += '.';
+      res.append(Scale - frac.size(), '0');
+      res += frac;
+    }
+    return res;
+  }
+
+  friend inline std::ostream & operator<<(std::ostream & out, decimal128 x)
+  {
+    return out << x.to_string();
+  }
+
+private :
+  // x * y as 192 bits: the low 128 are returned and the top limb goes to *top
+  CUDA_UINT128_API static inline uint128_t mul128x64(uint128_t x, uint64_t y, uint64_t * top)
+  {
+    uint128_t lo = mul128(x.lo, y), hi = mul128(x.hi, y);
+    uint128_t res;
+    res.lo = lo.lo;
+    res.hi = lo.hi + hi.lo;
+    *top = hi.hi + (res.hi < hi.lo);
+    return res;
+  }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+
+  Read-only search index over a sorted set of uint128_t keys.  The keys are
+  stored in Eytzinger (breadth first) order so that a search touches the top
+  of the tree in the same few cache lines every time, and the children four
+  levels down are prefetched while the current level is compared.  Batches of
+  queries are walked down the tree together so their cache misses overlap.
+
+  This is host only.
+
+*/
+
+#ifndef _UINT128_T_INDEX_CUDA_H
+#define _UINT128_T_INDEX_CUDA_H
+
+#include "cuda_uint128.h"
+
+class u128_static_index {
+public :
+  u128_static_index() : n(0) { }
+
+  /// [first, last) must be sorted in increasing order; duplicates are allowed
+  template <typename It>
+  u128_static_index(It first, It last)
+  {
+    std::vector<uint128_t> sorted(first, last);
+    n = sorted.size();
+    lines.resize((n + 1 + 3) / 4 + 4);
+    rank.resize(n + 1);
+    pos.resize(n);
+    build(sorted, 0, 1);
+    for(size_t k = 1; k <= n; k++) pos[rank[k]] = k;
+  }
+
+  explicit u128_static_index(const std::vector<uint128_t> & sorted)
+    : u128_static_index(sorted.begin(), sorted.end()) { }
+
+  size_t size() const {return n;}
+
+  /// Position in the sorted input of the first key >= x, or size() if all
+  /// keys are smaller, as with std::lower_bound.
+  size_t lower_bound(uint128_t x) const
+  {
+    const uint128_t * t = keys();
+    size_t k = 1;
+
+    while(k <= n){
+      prefetch(t, 16 * k);
+      k = 2 * k + (uint128_t::compare128(t[k], x) < 0);
+    }
+    return finish(k);
+  }
+
+  bool contains(uint128_t x) const
+  {
+    size_t i = lower_bound(x);
+    return i != n && key_at(i) == x;
+  }
+
+  /// out[i] = lower_bound(q[i]) for i < m
+  void lower_bound_batch(const uint128_t * q, size_t m, size_t * out) const
+  {
+    const size_t group = 16;
+    const uint128_t * t = keys();
+    int height = 0;
+    for(size_t k = n; k != 0; k >>= 1) height++;
+
+    for(size_t i = 0; i < m; i += group){
+      size_t g = m - i < group ? m - i : group;
+      size_t k[group];
+      for(size_t j = 0; j < g; j++) k[j] = 1;
+
+      for(int level = 0; level < height; level++){
+        for(size_t j = 0; j < g; j++){
+          if(k[j] > n) continue; // the last level is not full
+          prefetch(t, 16 * k[j]);
+          k[j] = 2 * k[j] + (uint128_t::compare128(t[k[j]], q[i + j]) < 0);
+        }
+      }
+      for(size_t j = 0; j < g; j++) out[i + j] = finish(k[j]);
+    }
+  }
+
+  /// The key at position i of the sorted input
+  uint128_t key_at(size_t i) const {return keys()[pos[i]];}
+
+private :
+  // keys()[k] for k in [1, n] is node k of the tree; node k has children 2k
+  // and 2k + 1.  The storage is cache line aligned, so nodes 4j..4j+3 (and
+  // the 16 descendants of a node four levels down) start on a line.
+  struct alignas(64) line {
+    uint128_t key[4];
+  };
+
+  size_t n;
+  std::vector<line> lines;
+  std::vector<size_t> rank; // node -> sorted position
+  std::vector<size_t> pos;  // sorted position -> node
+
+  const uint128_t * keys() const {return lines.empty() ? NULL : lines[0].key;}
+
+  // Node k's descendants four levels down can lie past the end of the
+  // array, where t + k would be undefined, so the address is computed as an
+  // integer; prefetching an unmapped address is harmless.
+  static void prefetch(const uint128_t * t, size_t k)
+  {
+  #if defined(__GNUC__) || defined(__clang__)
+    uintptr_t a = (uintptr_t) t + k * sizeof(uint128_t);
+    for(int i = 0; i < 4; i++)
+      __builtin_prefetch((const void *) (a + i * sizeof(line)));
+  #endif
+  }
+
+  // Walking down went right after the last node whose key was < x and left
+  // once at the answer, so the answer is k with its trailing ones and the
+  // final zero stripped.
+  size_t finish(size_t k) const
+  {
+    k >>= uint128_t::ctz64(~(uint64_t) k) + 1;
+    return k == 0 ? n : rank[k];
+  }
+
+  size_t build(const std::vector<uint128_t> & sorted, size_t i, size_t k)
+  {
+    if(k > n) return i;
+    i = build(sorted, i, 2 * k);
+    lines[k / 4].key[k % 4] = sorted[i];
+    rank[k] = i++;
+    return build(sorted, i, 2 * k + 1);
+  }
+};
+
+#endif
@@ -0,0 +1,375 @@
+/*
+
+  Bulk conversion between newline separated text files of uint128_t values
+  (decimal or hexadecimal) and flat binary arrays.
+  Input files are memory mapped and cut at newline boundaries into one piece
+  per thread; each thread parses its piece straight into the output array, so
+  no std::string is built per value.  Output is formatted by each thread into
+  its own buffer and the buffers are written out in order.  Every line must
+  hold exactly one value; the first line that does not is reported by number.
+
+  This is host only and uses POSIX mmap.
+
+*/
+
+#ifndef _UINT128_T_IO_CUDA_H
+#define _UINT128_T_IO_CUDA_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cuda_uint128.h"
+
+/// Bytes moved and time taken by one of the bulk calls below
+struct u128_io_stats {
+  uint64_t values;
+  uint64_t bytes;
+  double seconds;
+
+  double mb_per_s() const {return seconds > 0 ? bytes / seconds / 1e6 : 0;}
+};
+
+                        //////////////////////
+                        //  single values
+                        //////////////////////
+
+/// Parses the decimal (or, if hex, hexadecimal with an optional 0x prefix)
+/// number starting at p, stopping at the first character that is not a
+/// digit.  Returns the position after the last digit, or p itself if there
+/// are no digits.  Digits are gathered into a 64 bit word 19 (16 for hex) at
+/// a time, so there is one 128 bit multiply-add per word rather than per
+/// digit.  *overflow is set if the number does not fit; the result then
+/// wraps.
+inline const char * u128_parse(const char * p, const char * end, uint128_t * out, bool hex = false,
+                               bool * overflow = NULL)
+{
+  const char * start = p;
+  uint128_t res = 0;
+  bool of = false;
+
+  if(!hex){
+    while(p < end){
+      uint64_t word = 0;
+      int k = 0;
+      for(; k < 19 && p < end && (unsigned) (*p - '0') < 10; k++, p++)
+        word = word * 10 + (uint64_t) (*p - '0');
+      if(k == 0) break;
+      res = add128_overflow(mul128_overflow(res, pow10_128(k), &of), word, &of);
+      if(k < 19) break;
+    }
+  }else{
+    if(end - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x') p += 2;
+    const char * digits = p;
+    while(p < end){
+      uint64_t word = 0;
+      int k = 0;
+      for(; k < 16 && p < end; k++, p++){
+        unsigned c = (unsigned char) *p, d;
+        if(c - '0' < 10) d = c - '0';
+        else if((c | 0x20) - 'a' < 6) d = (c | 0x20) - 'a' + 10;
+        else break;
+        word = (word << 4) | d;
+      }
+      if(k == 0) break;
+      // the top 4k bits are shifted out
+      of = of || (k == 16 ? res.hi : res.hi >> (64 - 4 * k)) != 0;
+      res = (res << (4 * k)) | word;
+      if(k < 16) break;
+    }
+    if(p == digits) p = start;   // a bare 0x is not a number
+  }
+
+  *out = res;
+  if(overflow != NULL) *overflow = of;
+  return p;
+}
+
+/// Writes x into buf without a terminator and returns the length.  buf must
+/// hold 39 characters for decimal, 32 for hex (which has no 0x prefix).
+inline size_t u128_format(uint128_t x, char * buf, bool hex = false)
+{
+  char tmp[40];
+  char * q = tmp + sizeof(tmp);
+
+  if(hex){
+    static const char digits[] = "0123456789abcdef";
+    do{
+      *--q = digits[x.lo & 15];
+      x >>= 4;
+    }while(x != 0);
+  }else{
+    // three 64 bit pieces of at most 19 digits each, then plain 64 bit
+    // divisions by constants
+    const uint64_t p19 = 10000000000000000000ull;
+    uint64_t part[3];
+    int n = 0;
+    do{
+      uint64_t r;
+      x = div128to128(x, p19, &r);
+      part[n++] = r;
+    }while(x != 0);
+
+    for(int i = 0; i < n; i++){
+      uint64_t v = part[i];
+      if(i == n - 1){
+        do{
+          *--q = '0' + v % 10;
+          v /= 10;
+        }while(v != 0);
+      }else{
+        for(int d = 0; d < 19; d++){
+          *--q = '0' + v % 10;
+          v /= 10;
+        }
+      }
+    }
+  }
+
+  size_t len = tmp + sizeof(tmp) - q;
+  std::memcpy(buf, q, len);
+  return len;
+}
+
+                        //////////////////////
+                        //   bulk text
+                        //////////////////////
+
+/// A read-only memory map of a whole file
+class u128_mapped_file {
+public :
+  explicit u128_mapped_file(const std::string & path) : ptr(NULL), len(0), valid(false)
+  {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0) return;
+    if(fstat(fd, &st) == 0){
+      valid = true;
+      len = st.st_size;
+      if(len != 0){
+        void * m = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(m == MAP_FAILED){
+          valid = false;
+          len = 0;
+        }else{
+          ptr = (const char *) m;
+          madvise(m, len, MADV_SEQUENTIAL);
+        }
+      }
+    }
+    close(fd);
+  }
+
+  ~u128_mapped_file(){if(ptr != NULL) munmap((void *) ptr, len);}
+
+  bool ok() const {return valid;}
+  const char * data() const {return ptr;}
+  size_t size() const {return len;}
+
+private :
+  u128_mapped_file(const u128_mapped_file &);
+  u128_mapped_file & operator=(const u128_mapped_file &);
+
+  const char * ptr;
+  size_t len;
+  bool valid;
+};
+
+/// Calls f(begin, end) for every non-empty line of [p, end); a trailing '\r'
+/// is not part of the line.
+template <typename F>
+inline void u128_for_each_line(const char * p, const char * end, F f)
+{
+  while(p < end){
+    const char * nl = (const char *) std::memchr(p, '\n', end - p);
+    const char * e = nl != NULL ? nl : end;
+    const char * le = e > p && e[-1] == '\r' ? e - 1 : e;
+    if(le > p) f(p, le);
+    p = e + 1;
+  }
+}
+
+/// Start of the piece t of n pieces of [data, data + size), moved forward to
+/// the start of a line
+inline const char * u128_piece_start(const char * data, size_t size, int t, int n)
+{
+  size_t pos = size / n * t;
+  if(pos == 0) return data;
+  if(t == n) return data + size;
+  // a line starts at pos if the character before it is a newline
+  const char * nl = (const char *) std::memchr(data + pos - 1, '\n', size - pos + 1);
+  return nl != NULL ? nl + 1 : data + size;
+}
+
+/// Parses every non-empty line of a text buffer into *out.  Lines are
+/// counted first so each thread knows where in *out its piece goes.  A line
+/// must be exactly one number that fits in 128 bits; otherwise this returns
+/// false, leaves *out empty and stores the (1 based) number of the first bad
+/// line in *bad_line.
+inline bool u128_parse_lines(const char * data, size_t size, std::vector<uint128_t> * out, bool hex = false,
+                             size_t * bad_line = NULL)
+{
+  int threads = 1;
+#ifdef _OPENMP
+  threads = size < (1u << 20) ? 1 : omp_get_max_threads();
+#endif
+  std::vector<size_t> first(threads + 1, 0);
+
+  #pragma omp parallel for num_threads(threads)
+  for(int t = 0; t < threads; t++){
+    size_t n = 0;
+    u128_for_each_line(u128_piece_start(data, size, t, threads),
+                       u128_piece_start(data, size, t + 1, threads),
+                       [&n] (const char *, const char *) {n++;});
+    first[t + 1] = n;
+  }
+  for(int t = 0; t < threads; t++) first[t + 1] += first[t];
+
+  out->resize(first[threads]);
+  uint128_t * res = out->data();
+  std::vector<const char *> bad(threads, (const char *) NULL);
+
+  #pragma omp parallel for num_threads(threads)
+  for(int t = 0; t < threads; t++){
+    uint128_t * o = res + first[t];
+    const char * & b0 = bad[t];
+    u128_for_each_line(u128_piece_start(data, size, t, threads),
+                       u128_piece_start(data, size, t + 1, threads),
+                       [&o, &b0, hex] (const char * b, const char * e) {
+                         bool of;
+                         if((u128_parse(b, e, o++, hex, &of) != e || of) && b0 == NULL) b0 = b;
+                       });
+  }
+
+  // the pieces are in order, so the first piece with a bad line has the
+  // first bad line; its number is only worked out on this error path
+  for(int t = 0; t < threads; t++){
+    if(bad[t] != NULL){
+      if(bad_line != NULL) *bad_line = 1 + std::count(data, bad[t], '\n');
+      out->clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Reads a text file of one value per line into *out.  Returns false if the
+/// file cannot be read, with *bad_line set to 0, or if a line is not a valid
+/// value, with *bad_line set as by u128_parse_lines.
+inline bool u128_read_text(const std::string & path, std::vector<uint128_t> * out,
+                           bool hex = false, u128_io_stats * stats = NULL, size_t * bad_line = NULL)
+{
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  if(bad_line != NULL) *bad_line = 0;
+  u128_mapped_file f(path);
+  if(!f.ok()) return false;
+
+  if(!u128_parse_lines(f.data(), f.size(), out, hex, bad_line)) return false;
+
+  if(stats != NULL){
+    stats->values = out->size();
+    stats->bytes = f.size();
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  }
+  return true;
+}
+
+/// Writes one value per line.  Values are formatted a block at a time, each
+/// thread into its own buffer, and the buffers are appended in order, so the
+/// memory used does not grow with n.
+inline bool u128_write_text(const std::string & path, const uint128_t * v, size_t n,
+                            bool hex = false, u128_io_stats * stats = NULL)
+{
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  FILE * f = fopen(path.c_str(), "wb");
+  if(f == NULL) return false;
+
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  const size_t block = 1 << 16;   // values per thread per round
+  std::vector<std::vector<char> > buf(threads, std::vector<char>(block * 40));
+  std::vector<size_t> used(threads);
+  uint64_t bytes = 0;
+  bool ok = true;
+
+  for(size_t start = 0; start < n && ok; start += block * threads){
+    #pragma omp parallel for num_threads(threads)
+    for(int t = 0; t < threads; t++){
+      size_t b = start + t * block, e = b + block < n ? b + block : n;
+      char * q = buf[t].data();
+      for(size_t i = b; i < e; i++){
+        q += u128_format(v[i], q, hex);
+        *q++ = '\n';
+      }
+      used[t] = b < e ? q - buf[t].data() : 0;
+    }
+    for(int t = 0; t < threads && ok; t++){
+      ok = fwrite(buf[t].data(), 1, used[t], f) == used[t];
+      bytes += used[t];
+    }
+  }
+
+  ok = fclose(f) == 0 && ok;
+  if(stats != NULL){
+    stats->values = n;
+    stats->bytes = bytes;
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  }
+  return ok;
+}
+
+                        //////////////////////
+                        //   bulk binary
+                        //////////////////////
+
+// Binary files hold the values as consecutive (lo, hi) pairs of native
+// 64 bit words, the in-memory layout of uint128_t.
+
+inline bool u128_read_binary(const std::string & path, std::vector<uint128_t> * out,
+                             u128_io_stats * stats = NULL)
+{
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  u128_mapped_file f(path);
+  if(!f.ok() || f.size() % sizeof(uint128_t) != 0) return false;
+
+  out->resize(f.size() / sizeof(uint128_t));
+  if(f.size() != 0) std::memcpy((void *) out->data(), f.data(), f.size());
+
+  if(stats != NULL){
+    stats->values = out->size();
+    stats->bytes = f.size();
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  }
+  return true;
+}
+
+inline bool u128_write_binary(const std::string & path, const uint128_t * v, size_t n,
+                              u128_io_stats * stats = NULL)
+{
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  FILE * f = fopen(path.c_str(), "wb");
+  if(f == NULL) return false;
+
+  bool ok = fwrite(v, sizeof(uint128_t), n, f) == n;
+  ok = fclose(f) == 0 && ok;
+
+  if(stats != NULL){
+    stats->values = n;
+    stats->bytes = n * sizeof(uint128_t);
+    stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  }
+  return ok;
+}
+
+#endif
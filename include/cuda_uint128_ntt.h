@@ -0,0 +1,348 @@
+/*
+
+  Number-theoretic transforms for multiplying big integers (little endian
+  arrays of 64 bit limbs) and convolving arrays of 64 bit coefficients.
+
+  Products are computed modulo three primes just below 2^62 and put back
+  together with the Chinese remainder theorem, which is exact for
+  coefficients below their product, about 2^186.  That covers the
+  convolution of any two arrays of 64 bit values shorter than 2^41.  All
+  modular products are mul128 followed by a Montgomery reduction.
+
+  Transforms are radix 2.  The first levels sweep the whole array; once the
+  butterflies span at most ntt_prime_field::block_size values, each block of
+  that size is taken through all remaining levels while it is in cache.
+  Both kinds of work are spread across threads when OpenMP is enabled.
+  Short inputs go to a schoolbook product built on fma128 instead.
+
+  This is host only.
+
+*/
+
+#ifndef _UINT128_T_NTT_CUDA_H
+#define _UINT128_T_NTT_CUDA_H
+
+#include <algorithm>
+#include <vector>
+
+#if __cplusplus >= 202002L && defined __has_include
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+#include "cuda_uint128.h"
+
+/// Arithmetic modulo one NTT prime p < 2^62, with values in Montgomery form
+/// (x * 2^64 mod p) where noted, and the twiddle tables for transforms of
+/// up to 2^log_n values.
+class ntt_prime_field {
+public :
+  /// Butterflies spanning at most this many values run block by block
+  static const size_t block_size = 1 << 11;
+
+  /// p must be prime, below 2^62, with 2^log_n dividing p - 1; g must be a
+  /// generator of the multiplicative group mod p.
+  ntt_prime_field(uint64_t p, uint64_t g) : p(p), g(g), log_max(-1)
+  {
+    // p^-1 mod 2^64 by Newton's iteration, each step doubles the good bits
+    pinv = p;
+    for(int i = 0; i < 5; i++)
+      pinv *= 2 - p * pinv;
+
+    uint64_t r;
+    uint128_t::div128to64((uint128_t) 1 << 64, p, &r);
+    r1 = r;
+    uint128_t::div128to64(mul128(r1, r1), p, &r);
+    r2 = r;
+  }
+
+  uint64_t modulus() const {return p;}
+
+  /// t * 2^-64 mod p, for t < p * 2^64
+  uint64_t reduce(uint128_t t) const
+  {
+    uint64_t m = t.lo * pinv;
+    uint64_t mp = mul128(m, p).hi;   // m * p has the same low word as t
+    return t.hi - mp + (p & ((uint64_t) 0 - (t.hi < mp)));
+  }
+
+  /// a * b * 2^-64 mod p, so a product of Montgomery forms stays one
+  uint64_t mont_mul(uint64_t a, uint64_t b) const {return reduce(mul128(a, b));}
+
+  uint64_t to_mont(uint64_t a) const {return mont_mul(a % p, r2);}
+  uint64_t from_mont(uint64_t a) const {return reduce(a);}
+
+  // The corrections are masks rather than branches, which the butterflies
+  // could not predict.  p < 2^62, so the sign bit of a + b - p says whether
+  // it went negative.
+  uint64_t add(uint64_t a, uint64_t b) const {uint64_t s = a + b - p; return s + (p & ((uint64_t) 0 - (s >> 63)));}
+  uint64_t sub(uint64_t a, uint64_t b) const {return a - b + (p & ((uint64_t) 0 - (a < b)));}
+
+  /// a^e with a in Montgomery form, result in Montgomery form
+  uint64_t mont_pow(uint64_t a, uint64_t e) const
+  {
+    uint64_t res = r1;
+    for(; e != 0; e >>= 1){
+      if(e & 1) res = mont_mul(res, a);
+      a = mont_mul(a, a);
+    }
+    return res;
+  }
+
+  /// Builds the twiddle tables for lengths up to 2^log_n.  Entry h + j of a
+  /// table is w^j for the root of unity w of order 2h, in Montgomery form,
+  /// so each level of a transform reads its twiddles in order.
+  void prepare(int log_n)
+  {
+    if(log_n <= log_max) return;
+    const size_t n = (size_t) 1 << log_n;
+    root.assign(n, 0);
+    iroot.assign(n, 0);
+
+    const uint64_t gm = to_mont(g);
+    for(size_t h = 1; h < n; h <<= 1){
+      uint64_t w = mont_pow(gm, (p - 1) / (2 * h));
+      uint64_t iw = mont_pow(w, p - 2);
+      uint64_t x = r1, ix = r1;
+      for(size_t j = 0; j < h; j++){
+        root[h + j] = x;
+        iroot[h + j] = ix;
+        x = mont_mul(x, w);
+        ix = mont_mul(ix, iw);
+      }
+    }
+    log_max = log_n;
+  }
+
+  /// Forward transform of 2^log_n values below p, in place.  The output is
+  /// in bit reversed order, which is what inverse() takes.
+  void forward(uint64_t * a, int log_n) const
+  {
+    const size_t n = (size_t) 1 << log_n;
+    size_t h = n / 2;
+    if(h == 0) return;
+
+    for(; 2 * h > block_size; h /= 2){
+      #pragma omp parallel for schedule(static)
+      for(int64_t t = 0; t < (int64_t) (n / 2); t++){
+        size_t j = (size_t) t & (h - 1), s = ((size_t) t - j) * 2;
+        dif(a + s + j, a + s + j + h, root[h + j]);
+      }
+    }
+
+    const size_t bs = 2 * h;
+    #pragma omp parallel for schedule(static)
+    for(int64_t b = 0; b < (int64_t) (n / bs); b++){
+      uint64_t * blk = a + b * bs;
+      for(size_t hh = h; hh >= 1; hh /= 2)
+        for(size_t s = 0; s < bs; s += 2 * hh)
+          for(size_t j = 0; j < hh; j++)
+            dif(blk + s + j, blk + s + j + hh, root[hh + j]);
+    }
+  }
+
+  /// Inverse of forward(), without the division by 2^log_n
+  void inverse(uint64_t * a, int log_n) const
+  {
+    const size_t n = (size_t) 1 << log_n;
+    const size_t bs = n < block_size ? n : block_size;
+
+    #pragma omp parallel for schedule(static)
+    for(int64_t b = 0; b < (int64_t) (n / bs); b++){
+      uint64_t * blk = a + b * bs;
+      for(size_t hh = 1; hh < bs; hh *= 2)
+        for(size_t s = 0; s < bs; s += 2 * hh)
+          for(size_t j = 0; j < hh; j++)
+            dit(blk + s + j, blk + s + j + hh, iroot[hh + j]);
+    }
+
+    for(size_t h = bs; h < n; h *= 2){
+      #pragma omp parallel for schedule(static)
+      for(int64_t t = 0; t < (int64_t) (n / 2); t++){
+        size_t j = (size_t) t & (h - 1), s = ((size_t) t - j) * 2;
+        dit(a + s + j, a + s + j + h, iroot[h + j]);
+      }
+    }
+  }
+
+  /// a[i] = a[i] * b[i] * c * 2^-128 mod p.  With c = n^-1 * 2^128 mod p
+  /// (see scale()) this is the pointwise product of two transforms with the
+  /// final division folded in, and the Montgomery factors cancel.
+  void pointwise(uint64_t * a, const uint64_t * b, size_t n, uint64_t c) const
+  {
+    #pragma omp parallel for schedule(static)
+    for(int64_t i = 0; i < (int64_t) n; i++)
+      a[i] = mont_mul(mont_mul(a[i], b[i]), c);
+  }
+
+  /// The c for pointwise() that undoes the factor 2^log_n of a round trip
+  uint64_t scale(int log_n) const
+  {
+    // n^-1 * 2^128 is (n^-1 * 2^64) in Montgomery form
+    uint64_t n_inv = mont_pow(mont_mul(r2, (uint64_t) 1 << log_n), p - 2);
+    return mont_mul(n_inv, r2);
+  }
+
+private :
+  uint64_t p, g, pinv;
+  uint64_t r1, r2;      // 2^64 and 2^128 mod p
+  int log_max;
+  std::vector<uint64_t> root, iroot;
+
+  // Twiddles are in Montgomery form, so mont_mul by one is a plain product
+  void dif(uint64_t * x, uint64_t * y, uint64_t w) const
+  {
+    uint64_t u = *x, v = *y;
+    *x = add(u, v);
+    *y = mont_mul(sub(u, v), w);
+  }
+
+  void dit(uint64_t * x, uint64_t * y, uint64_t w) const
+  {
+    uint64_t u = *x, v = mont_mul(*y, w);
+    *x = add(u, v);
+    *y = sub(u, v);
+  }
+};
+
+/// Below this many limbs in the shorter input the schoolbook product is used
+#define NTT_SCHOOLBOOK_LIMBS 512
+
+/// Calls f(k, x0, x1, x2) with the 192 bit coefficient x0 + x1 * 2^64 +
+/// x2 * 2^128 of every power k < na + nb - 1 of the convolution of a and b.
+template <typename F>
+inline void ntt_convolve_crt(const uint64_t * a, size_t na, const uint64_t * b, size_t nb, F f)
+{
+  static const uint64_t primes[3][2] = {
+    {0x3fffc00000000001ull, 11},    // 65535 * 2^46 + 1
+    {0x3fffbe0000000001ull, 3},     // 2097119 * 2^41 + 1
+    {0x3fff840000000001ull, 19},    // 1048545 * 2^42 + 1
+  };
+  const size_t nc = na + nb - 1;
+  int log_n = 0;
+  while(((size_t) 1 << log_n) < nc) log_n++;
+  const size_t n = (size_t) 1 << log_n;
+
+  std::vector<ntt_prime_field> field;
+  std::vector<std::vector<uint64_t> > res(3);
+  std::vector<uint64_t> tb(n);
+  field.reserve(3);
+
+  for(int k = 0; k < 3; k++){
+    field.push_back(ntt_prime_field(primes[k][0], primes[k][1]));
+    ntt_prime_field & fk = field[k];
+    const uint64_t p = fk.modulus();
+    fk.prepare(log_n);
+
+    std::vector<uint64_t> & ta = res[k];
+    ta.assign(n, 0);
+    for(size_t i = 0; i < na; i++) ta[i] = a[i] % p;
+    for(size_t i = 0; i < nb; i++) tb[i] = b[i] % p;
+    std::fill(tb.begin() + nb, tb.end(), 0);
+
+    fk.forward(ta.data(), log_n);
+    fk.forward(tb.data(), log_n);
+    fk.pointwise(ta.data(), tb.data(), n, fk.scale(log_n));
+    fk.inverse(ta.data(), log_n);
+  }
+
+  // Garner: x = r0 + p0 * (t1 + p1 * t2) with t1 < p1 and t2 < p2
+  const ntt_prime_field & f1 = field[1], & f2 = field[2];
+  const uint64_t p0 = primes[0][0], p1 = primes[1][0], p2 = primes[2][0];
+  const uint64_t p0_inv1 = f1.mont_pow(f1.to_mont(p0), p1 - 2);     // 1 / p0 mod p1
+  const uint64_t p0_inv2 = f2.mont_pow(f2.to_mont(p0), p2 - 2);     // 1 / p0 mod p2
+  const uint64_t p1_inv2 = f2.mont_pow(f2.to_mont(p1), p2 - 2);     // 1 / p1 mod p2
+
+  for(size_t i = 0; i < nc; i++){
+    uint64_t r0 = res[0][i], r1 = res[1][i], r2 = res[2][i];
+    // Montgomery products with a Montgomery form constant are plain products
+    uint64_t t1 = f1.mont_mul(f1.sub(r1, r0 >= p1 ? r0 - p1 : r0), p0_inv1);
+    // p0 and p1 are less than twice p2, so one subtraction reduces r0 and t1
+    uint64_t t2 = f2.mont_mul(f2.sub(r2, r0 >= p2 ? r0 - p2 : r0), p0_inv2);
+    t2 = f2.mont_mul(f2.sub(t2, t1 >= p2 ? t1 - p2 : t1), p1_inv2);
+
+    uint128_t u = fma128(p1, t2, t1);
+    uint128_t x = fma128(p0, u.lo, r0);
+    uint128_t y = fma128(p0, u.hi, x.hi);
+    f(i, x.lo, y.lo, y.hi);
+  }
+}
+
+/// Product of the na limb number a and the nb limb number b (little endian
+/// 64 bit limbs) into out[0], ..., out[na + nb - 1].  out must not overlap
+/// the inputs.
+inline void ntt_multiply(const uint64_t * a, size_t na, const uint64_t * b, size_t nb, uint64_t * out)
+{
+  if(na == 0 || nb == 0){
+    std::fill(out, out + na + nb, 0);
+    return;
+  }
+
+  if(na < NTT_SCHOOLBOOK_LIMBS || nb < NTT_SCHOOLBOOK_LIMBS){
+    std::fill(out, out + na + nb, 0);
+    for(size_t i = 0; i < na; i++){
+      uint128_t acc = 0;
+      for(size_t j = 0; j < nb; j++){
+        acc = fma128(a[i], b[j], acc + out[i + j]);
+        out[i + j] = acc.lo;
+        acc = acc.hi;
+      }
+      out[i + nb] = acc.lo;
+    }
+    return;
+  }
+
+  // the carry into the next limb stays below 2^128
+  uint128_t carry = 0;
+  ntt_convolve_crt(a, na, b, nb,
+    [out, &carry] (size_t k, uint64_t x0, uint64_t x1, uint64_t x2) {
+      uint128_t s = carry + x0, x;
+      out[k] = s.lo;
+      x.lo = x1;
+      x.hi = x2;
+      carry = x + s.hi;
+    });
+  out[na + nb - 1] = carry.lo;
+}
+
+inline std::vector<uint64_t> ntt_multiply(const std::vector<uint64_t> & a, const std::vector<uint64_t> & b)
+{
+  std::vector<uint64_t> res(a.size() + b.size());
+  ntt_multiply(a.data(), a.size(), b.data(), b.size(), res.data());
+  return res;
+}
+
+#ifdef __cpp_lib_span
+inline std::vector<uint64_t> ntt_multiply(std::span<const uint64_t> a, std::span<const uint64_t> b)
+{
+  std::vector<uint64_t> res(a.size() + b.size());
+  ntt_multiply(a.data(), a.size(), b.data(), b.size(), res.data());
+  return res;
+}
+#endif
+
+/// Convolution of two arrays of 64 bit coefficients, out[k] = sum of
+/// a[i] * b[k - i], into out[0], ..., out[na + nb - 2].  Coefficients are
+/// exact below 2^128 and wrap around mod 2^128 otherwise, as with uint128_t
+/// arithmetic.
+inline void ntt_convolve(const uint64_t * a, size_t na, const uint64_t * b, size_t nb, uint128_t * out)
+{
+  if(na == 0 || nb == 0) return;
+
+  if(na < NTT_SCHOOLBOOK_LIMBS || nb < NTT_SCHOOLBOOK_LIMBS){
+    std::fill(out, out + na + nb - 1, uint128_t(0));
+    for(size_t i = 0; i < na; i++)
+      for(size_t j = 0; j < nb; j++)
+        out[i + j] = fma128(a[i], b[j], out[i + j]);
+    return;
+  }
+
+  ntt_convolve_crt(a, na, b, nb,
+    [out] (size_t k, uint64_t x0, uint64_t x1, uint64_t) {
+      out[k].lo = x0;
+      out[k].hi = x1;
+    });
+}
+
+#endif
@@ -0,0 +1,171 @@
+/*
+
+  basic_uint128<OverflowPolicy>, a uint128_t whose +, -, * and / follow a
+  chosen overflow policy:
+
+    u128_wrap      - wrap around mod 2^128, like uint128_t
+    u128_saturate  - clamp to 0 or 2^128 - 1
+    u128_checked   - wrap, and carry a sticky overflow flag that is passed on
+                     to every result computed from the value
+    u128_trap      - stop the program (__trap on the device)
+
+  Overflow is detected with add128_overflow and friends, so the policy only
+  decides what to do with a result and a flag that are already there; for
+  all but u128_trap this is a select rather than a branch.  Division by zero
+  counts as an overflow with a wrapped result of 0.
+
+  basic_uint128 converts implicitly to uint128_t, so it can be handed to any
+  function taking one.  uint128_t itself is unchanged and keeps wrapping.
+
+*/
+
+#ifndef _UINT128_T_OVERFLOW_CUDA_H
+#define _UINT128_T_OVERFLOW_CUDA_H
+
+#include <cstdlib>
+
+#include "cuda_uint128.h"
+
+/// Policies are base classes of basic_uint128.  handle() gets the wrapped
+/// result, the value to saturate to and whether the operation overflowed,
+/// and returns the result to keep; merge() takes over the state of another
+/// operand.
+struct u128_wrap {
+  CUDA_UINT128_API uint128_t handle(uint128_t res, uint128_t, bool) {return res;}
+  CUDA_UINT128_API void merge(const u128_wrap &) { }
+  CUDA_UINT128_API bool overflowed() const {return false;}
+};
+
+struct u128_saturate {
+  CUDA_UINT128_API uint128_t handle(uint128_t res, uint128_t sat, bool of)
+  {
+    uint64_t m = (uint64_t) 0 - (uint64_t) of;
+    res.lo = (res.lo & ~m) | (sat.lo & m);
+    res.hi = (res.hi & ~m) | (sat.hi & m);
+    return res;
+  }
+  CUDA_UINT128_API void merge(const u128_saturate &) { }
+  CUDA_UINT128_API bool overflowed() const {return false;}
+};
+
+struct u128_checked {
+  bool overflow;
+
+  CUDA_UINT128_API u128_checked() : overflow(false) { }
+
+  CUDA_UINT128_API uint128_t handle(uint128_t res, uint128_t, bool of)
+  {
+    overflow |= of;
+    return res;
+  }
+  CUDA_UINT128_API void merge(const u128_checked & b) {overflow |= b.overflow;}
+  CUDA_UINT128_API bool overflowed() const {return overflow;}
+  CUDA_UINT128_API void clear_overflow() {overflow = false;}
+};
+
+struct u128_trap {
+  CUDA_UINT128_API uint128_t handle(uint128_t res, uint128_t, bool of)
+  {
+    if(of){
+    #ifdef __CUDA_ARCH__
+      __trap();
+    #elif __GNUC__ || uint128_t_has_builtin(__builtin_trap)
+      __builtin_trap();
+    #else
+      std::abort();
+    #endif
+    }
+    return res;
+  }
+  CUDA_UINT128_API void merge(const u128_trap &) { }
+  CUDA_UINT128_API bool overflowed() const {return false;}
+};
+
+template <typename OverflowPolicy>
+class basic_uint128 : public OverflowPolicy {
+public :
+  typedef OverflowPolicy policy_type;
+
+  CUDA_UINT128_API basic_uint128() : v() { }
+  CUDA_UINT128_API basic_uint128(uint128_t x) : v(x) { }
+
+  template <
+    typename T,
+    typename = typename std::enable_if<std::is_arithmetic<T>::value, T>::type
+  >
+  CUDA_UINT128_API basic_uint128(const T & x) : v(x) { }
+
+  CUDA_UINT128_API uint128_t value() const {return v;}
+  CUDA_UINT128_API operator uint128_t() const {return v;}
+
+  CUDA_UINT128_API friend basic_uint128 operator+(basic_uint128 a, const basic_uint128 & b)
+  {
+    bool of = false;
+    uint128_t res = uint128_t::add128_overflow(a.v, b.v, &of);
+    return a.combine(b, res, ~uint128_t(), of);
+  }
+
+  CUDA_UINT128_API friend basic_uint128 operator-(basic_uint128 a, const basic_uint128 & b)
+  {
+    bool of = false;
+    uint128_t res = uint128_t::sub128_overflow(a.v, b.v, &of);
+    return a.combine(b, res, uint128_t(), of);
+  }
+
+  CUDA_UINT128_API friend basic_uint128 operator*(basic_uint128 a, const basic_uint128 & b)
+  {
+    bool of = false;
+    uint128_t res = uint128_t::mul128_overflow(a.v, b.v, &of);
+    return a.combine(b, res, ~uint128_t(), of);
+  }
+
+  CUDA_UINT128_API friend basic_uint128 operator/(basic_uint128 a, const basic_uint128 & b)
+  {
+    bool of = false;
+    uint128_t res = uint128_t::div128_overflow(a.v, b.v, &of);
+    return a.combine(b, res, ~uint128_t(), of);
+  }
+
+  /// The remainder of a division by zero is 0 for every policy
+  CUDA_UINT128_API friend basic_uint128 operator%(basic_uint128 a, const basic_uint128 & b)
+  {
+    bool of = false;
+    uint128_t res;
+    uint128_t::div128_overflow(a.v, b.v, &of, &res);
+    return a.combine(b, res, uint128_t(), of);
+  }
+
+  CUDA_UINT128_API basic_uint128 & operator+=(const basic_uint128 & b){return *this = *this + b;}
+  CUDA_UINT128_API basic_uint128 & operator-=(const basic_uint128 & b){return *this = *this - b;}
+  CUDA_UINT128_API basic_uint128 & operator*=(const basic_uint128 & b){return *this = *this * b;}
+  CUDA_UINT128_API basic_uint128 & operator/=(const basic_uint128 & b){return *this = *this / b;}
+  CUDA_UINT128_API basic_uint128 & operator%=(const basic_uint128 & b){return *this = *this % b;}
+  CUDA_UINT128_API basic_uint128 & operator++(){return *this += 1;}
+  CUDA_UINT128_API basic_uint128 & operator--(){return *this -= 1;}
+
+  // Comparisons take a plain uint128_t like those of uint128_t itself, so
+  // the other operand can be any basic_uint128, uint128_t or integer.
+  CUDA_UINT128_API bool operator==(uint128_t b) const {return v == b;}
+  CUDA_UINT128_API bool operator!=(uint128_t b) const {return v != b;}
+  CUDA_UINT128_API bool operator<(uint128_t b) const {return v < b;}
+  CUDA_UINT128_API bool operator>(uint128_t b) const {return v > b;}
+  CUDA_UINT128_API bool operator<=(uint128_t b) const {return !(v > b);}
+  CUDA_UINT128_API bool operator>=(uint128_t b) const {return !(v < b);}
+
+private :
+  uint128_t v;
+
+  CUDA_UINT128_API basic_uint128 & combine(const basic_uint128 & b, uint128_t res, uint128_t sat, bool of)
+  {
+    this->merge(b);
+    v = this->handle(res, sat, of);
+    return *this;
+  }
+};
+
+typedef basic_uint128<u128_wrap> wrapping_uint128_t;
+typedef basic_uint128<u128_saturate> saturating_uint128_t;
+typedef basic_uint128<u128_checked> checked_uint128_t;
+typedef basic_uint128<u128_trap> trapping_uint128_t;
+
+#endif
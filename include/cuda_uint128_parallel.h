@@ -0,0 +1,159 @@
+/*
+
+  Sweeping ranges of uint128_t.  uint128_counting_iterator is a random access
+  iterator over consecutive uint128_t values that STL and Thrust algorithms
+  can split like any other.  parallel_for_u128 visits begin, begin + step, ...
+  below end, handing chunks of the range to OpenMP threads on the host, or to
+  Thrust on the device with parallel_for_u128_device when built with nvcc.
+
+  Either way the callback is invoked as fn(base, offset) with a 128 bit chunk
+  base and a 64 bit offset from it, so the per item work is a 64 bit add.
+
+*/
+
+#ifndef _UINT128_T_PARALLEL_CUDA_H
+#define _UINT128_T_PARALLEL_CUDA_H
+
+#include "cuda_uint128.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __CUDACC__
+#include <thrust/for_each.h>
+#include <thrust/iterator/counting_iterator.h>
+#endif
+
+/// Iterator whose value is a uint128_t counter.  Distances between two
+/// iterators are int64_t, so algorithms that take the distance of a range
+/// need ranges shorter than 2^63; parallel_for_u128 has no such limit.
+class uint128_counting_iterator {
+public :
+  typedef std::random_access_iterator_tag iterator_category;
+  typedef uint128_t value_type;
+  typedef int64_t difference_type;
+  typedef const uint128_t * pointer;
+  typedef uint128_t reference;
+
+  CUDA_UINT128_API uint128_counting_iterator() : value() { }
+  CUDA_UINT128_API explicit uint128_counting_iterator(uint128_t v) : value(v) { }
+
+  CUDA_UINT128_API uint128_t operator*() const {return value;}
+  CUDA_UINT128_API uint128_t operator[](difference_type n) const {return value + (uint128_t) n;}
+
+  CUDA_UINT128_API uint128_counting_iterator & operator++(){value += 1; return *this;}
+  CUDA_UINT128_API uint128_counting_iterator & operator--(){value -= 1; return *this;}
+  CUDA_UINT128_API uint128_counting_iterator operator++(int){uint128_counting_iterator t = *this; ++*this; return t;}
+  CUDA_UINT128_API uint128_counting_iterator operator--(int){uint128_counting_iterator t = *this; --*this; return t;}
+
+  // n is sign extended, so adding a negative n wraps around to a subtraction
+  CUDA_UINT128_API uint128_counting_iterator & operator+=(difference_type n){value = value + (uint128_t) n; return *this;}
+  CUDA_UINT128_API uint128_counting_iterator & operator-=(difference_type n){value = value - (uint128_t) n; return *this;}
+
+  CUDA_UINT128_API uint128_counting_iterator operator+(difference_type n) const {uint128_counting_iterator t = *this; return t += n;}
+  CUDA_UINT128_API uint128_counting_iterator operator-(difference_type n) const {uint128_counting_iterator t = *this; return t -= n;}
+  CUDA_UINT128_API friend uint128_counting_iterator operator+(difference_type n, uint128_counting_iterator it){return it += n;}
+
+  CUDA_UINT128_API difference_type operator-(uint128_counting_iterator b) const {return (difference_type) (value - b.value).lo;}
+
+  CUDA_UINT128_API bool operator==(uint128_counting_iterator b) const {return value == b.value;}
+  CUDA_UINT128_API bool operator!=(uint128_counting_iterator b) const {return value != b.value;}
+  CUDA_UINT128_API bool operator<(uint128_counting_iterator b) const {return value < b.value;}
+  CUDA_UINT128_API bool operator>(uint128_counting_iterator b) const {return value > b.value;}
+  CUDA_UINT128_API bool operator<=(uint128_counting_iterator b) const {return !(value > b.value);}
+  CUDA_UINT128_API bool operator>=(uint128_counting_iterator b) const {return !(value < b.value);}
+
+private :
+  uint128_t value;
+};
+
+/// Number of items in begin, begin + step, ... below end
+CUDA_UINT128_API inline uint128_t u128_range_count(uint128_t begin, uint128_t end, uint64_t step)
+{
+  if(!(begin < end) || step == 0) return 0;
+  uint64_t r;
+  uint128_t n = div128to128(end - begin, step, &r);
+  return r != 0 ? n + 1 : n;
+}
+
+/// Items per chunk when splitting n items into about the given number of
+/// chunks, capped so that offsets within a chunk stay below 2^64.
+inline uint64_t u128_chunk_items(uint128_t n, uint64_t step, uint64_t chunks)
+{
+  uint64_t limit = (uint64_t) -1 / step;
+  uint128_t per = div128to128(n, chunks);
+  uint64_t items = per.hi != 0 || per.lo > limit ? limit : per.lo;
+  return items == 0 ? 1 : items;
+}
+
+/// Calls fn(base, offset) for every item base + offset of begin, begin +
+/// step, ... below end.  The range is cut into chunks of up to 2^64 / step
+/// items that OpenMP threads take from a shared queue, so threads that finish
+/// early pick up more of the remaining work.  fn is called concurrently.
+template <typename F>
+void parallel_for_u128(uint128_t begin, uint128_t end, uint64_t step, F fn)
+{
+  const uint128_t n = u128_range_count(begin, end, step);
+  if(n == 0) return;
+
+  int threads = 1;
+#ifdef _OPENMP
+  threads = omp_get_max_threads();
+#endif
+  const uint64_t chunk = u128_chunk_items(n, step, 16 * (uint64_t) threads);
+  const uint64_t chunk_span = chunk * step;
+
+  // chunk counts can exceed 64 bits for huge ranges, so hand them out in
+  // rounds of at most 2^32
+  uint64_t r;
+  uint128_t chunks = div128to128(n, chunk, &r);
+  if(r != 0) chunks = chunks + 1;
+  uint128_t round_base = begin, done = 0;
+
+  while(chunks != 0){
+    uint64_t round = chunks.hi != 0 || chunks.lo > (1ull << 32) ? 1ull << 32 : chunks.lo;
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int64_t c = 0; c < (int64_t) round; c++){
+      uint128_t first = done + mul128((uint64_t) c, chunk);
+      uint128_t left = n - first;
+      uint64_t items = left.hi != 0 || left.lo > chunk ? chunk : left.lo;
+      uint128_t base = round_base + mul128((uint64_t) c, chunk_span);
+
+      for(uint64_t i = 0, offset = 0; i < items; i++, offset += step)
+        fn(base, offset);
+    }
+
+    chunks = chunks - round;
+    done = done + mul128(round, chunk);
+    round_base = round_base + mul128(mul128(round, chunk), step);
+  }
+}
+
+#ifdef __CUDACC__
+/// parallel_for_u128 on the device: each chunk of up to 2^62 items is one
+/// thrust::for_each launch over 64 bit indices.  fn must be callable from
+/// device code.
+template <typename F>
+void parallel_for_u128_device(uint128_t begin, uint128_t end, uint64_t step, F fn)
+{
+  uint128_t n = u128_range_count(begin, end, step);
+  uint64_t chunk = (1ull << 62) / step;
+  if(chunk == 0) chunk = 1;
+
+  while(n != 0){
+    uint64_t items = n.hi != 0 || n.lo > chunk ? chunk : n.lo;
+    const uint128_t base = begin;
+    thrust::counting_iterator<uint64_t> i(0);
+    thrust::for_each(i, i + items,
+      [=] __device__ (uint64_t k) {
+        fn(base, k * step);
+      });
+    n = n - items;
+    begin = begin + mul128(items, step);
+  }
+}
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+/*
+
+  Segmented sieve over 128-bit ranges.  Every number in [start, start + length)
+  that has no prime factor up to a chosen bound is handed to a callback.  The
+  range is covered by L1-sized segments holding only the numbers coprime to 30
+  (one byte per 30 integers), so memory use does not depend on the length of
+  the range.  Segments are spread across threads when OpenMP is enabled.
+
+  This is host only.
+
+*/
+
+#ifndef _UINT128_T_SIEVE_CUDA_H
+#define _UINT128_T_SIEVE_CUDA_H
+
+#include <atomic>
+#include <cstring>
+
+#include "cuda_uint128.h"
+
+class uint128_sieve {
+public :
+  /// prime_bound is the largest prime that is sieved out (2, 3 and 5 are
+  /// always removed by the wheel).  segment_bytes is the size of the bit
+  /// segment each thread works on; the default fits in a 32 KiB L1 cache.
+  uint128_sieve(uint32_t prime_bound, uint32_t segment_bytes = 32768)
+    : seg_bytes(segment_bytes < 8 ? 8 : segment_bytes & ~7u)
+  {
+    std::vector<uint8_t> composite((size_t) prime_bound + 1, 0);
+    for(uint64_t i = 2; i <= prime_bound; i++){
+      if(composite[i]) continue;
+      for(uint64_t j = i * i; j <= prime_bound; j += i)
+        composite[j] = 1;
+      if(i <= 5) continue;
+
+      sieve_prime sp;
+      sp.p = (uint32_t) i;
+      sp.inv30 = (uint32_t) powmod(30, i - 2, i);
+      sp.span_mod = (uint32_t) (span() % i);
+      primes.push_back(sp);
+    }
+  }
+
+  /// Calls f(n) for every n in [start, start + length) with no prime factor
+  /// up to the bound.  Values are produced in increasing order within a
+  /// segment, but when OpenMP is enabled f is called concurrently from
+  /// several threads and segments complete in no particular order.
+  template <typename F>
+  void run(uint128_t start, uint64_t length, F f) const
+  {
+    for_each_segment(start, length,
+      [&f] (uint128_t base, const uint8_t * bits, uint32_t nbytes) {
+        for(uint32_t w = 0; w < nbytes; w += 8){
+          uint64_t word;
+          std::memcpy(&word, bits + w, 8);
+          while(word != 0){
+            int b = uint128_t::ctz64(word);
+            word &= word - 1;
+            f(base + (uint64_t) (30 * (w + (b >> 3)) + wheel(b & 7)));
+          }
+        }
+      });
+  }
+
+  /// Number of values run() would produce for the same range.
+  uint64_t count(uint128_t start, uint64_t length) const
+  {
+    std::atomic<uint64_t> total(0);
+    for_each_segment(start, length,
+      [&total] (uint128_t, const uint8_t * bits, uint32_t nbytes) {
+        uint64_t n = 0;
+        for(uint32_t w = 0; w < nbytes; w += 8){
+          uint64_t word;
+          std::memcpy(&word, bits + w, 8);
+          n += uint128_t::popcount64(word);
+        }
+        total += n;
+      });
+    return total;
+  }
+
+  /// Calls f(base, bits, nbytes) once per segment.  Bit i of bits[j] stands
+  /// for base + 30 * j + wheel(i) and is set if that number survived.  Bits
+  /// outside the requested range are already cleared and nbytes is a multiple
+  /// of 8.
+  template <typename F>
+  void for_each_segment(uint128_t start, uint64_t length, F f) const
+  {
+    if(length == 0) return;
+
+    uint64_t first;
+    uint128_t base0 = uint128_t::div128to128(start, 30, &first);
+    base0 = mul128(base0, 30);
+
+    const uint128_t end = (uint128_t) first + length;   // relative to base0
+    const uint64_t  nseg = uint128_t::div128to64(end + (span() - 1), span());
+
+    std::vector<uint32_t> base_mod(primes.size());
+    for(size_t k = 0; k < primes.size(); k++){
+      uint64_t r;
+      uint128_t::div128to128(base0, primes[k].p, &r);
+      base_mod[k] = (uint32_t) r;
+    }
+
+    #pragma omp parallel
+    {
+      std::vector<uint8_t> seg(seg_bytes);
+
+      #pragma omp for schedule(dynamic)
+      for(int64_t s = 0; s < (int64_t) nseg; s++){
+        uint128_t rel = mul128((uint64_t) s, span());
+        uint128_t left = end - rel;
+        uint64_t hi_off = left.hi != 0 || left.lo > span() ? span() : left.lo;
+        uint64_t lo_off = s == 0 ? first : 0;
+        uint32_t nbytes = (uint32_t) ((hi_off + 29) / 30 + 7) & ~7u;
+
+        std::memset(seg.data(), 0xff, nbytes);
+        cross_off(seg.data(), nbytes, (uint64_t) s, base_mod);
+        clear_edges(seg.data(), nbytes, lo_off, hi_off);
+        f(base0 + rel, (const uint8_t *) seg.data(), nbytes);
+      }
+    }
+  }
+
+  /// The residues mod 30 kept by the wheel, in bit order.
+  static inline uint32_t wheel(int i)
+  {
+    static const uint32_t w[8] = {1, 7, 11, 13, 17, 19, 23, 29};
+    return w[i];
+  }
+
+private :
+  struct sieve_prime {
+    uint32_t p;
+    uint32_t inv30;     // 30^-1 mod p
+    uint32_t span_mod;  // span() mod p
+  };
+
+  uint32_t seg_bytes;
+  std::vector<sieve_prime> primes;
+
+  uint64_t span() const {return 30ull * seg_bytes;}
+
+  static uint64_t powmod(uint64_t b, uint64_t e, uint64_t m)
+  {
+    uint64_t res = 1;
+    b %= m;
+    for(; e != 0; e >>= 1){
+      if(e & 1) res = res * b % m;
+      b = b * b % m;
+    }
+    return res;
+  }
+
+  // Segment s starts at base0 + s * span().  Its residue mod p comes from one
+  // 128 by 64 bit remainder; the high word of s * span_mod is always below p,
+  // so div128to64 never takes its overflow exit here.
+  void cross_off(uint8_t * seg, uint32_t nbytes, uint64_t s,
+                 const std::vector<uint32_t> & base_mod) const
+  {
+    for(size_t k = 0; k < primes.size(); k++){
+      const uint64_t p = primes[k].p;
+      uint64_t r;
+      uint128_t::div128to64(mul128(s, primes[k].span_mod), p, &r);
+      r += base_mod[k];
+      if(r >= p) r -= p;
+
+      for(int i = 0; i < 8; i++){
+        // smallest j with base + 30 * j + wheel(i) == 0 mod p
+        uint64_t t = (r + wheel(i)) % p;
+        uint64_t j = (t == 0 ? 0 : p - t) * primes[k].inv30 % p;
+        const uint8_t mask = ~(uint8_t) (1u << i);
+        for(; j < nbytes; j += p)
+          seg[j] &= mask;
+      }
+    }
+  }
+
+  static void clear_edges(uint8_t * seg, uint32_t nbytes, uint64_t lo_off, uint64_t hi_off)
+  {
+    for(int i = 0; i < 8; i++){
+      if(wheel(i) < lo_off)
+        seg[0] &= ~(uint8_t) (1u << i);
+    }
+    uint64_t last = (hi_off - 1) / 30;
+    for(int i = 0; i < 8; i++){
+      if(30 * last + wheel(i) >= hi_off)
+        seg[last] &= ~(uint8_t) (1u << i);
+    }
+    for(uint64_t j = last + 1; j < nbytes; j++)
+      seg[j] = 0;
+  }
+};
+
+#endif
@@ -1,8 +1,18 @@
 #include <cstdio>
 #include <cstdint>
+#include <algorithm>
 #include <gtest/gtest.h>
 
 #include "cuda_uint128.h"
+#include "cuda_uint128_clmul.h"
+#include "cuda_uint128_compress.h"
+#include "cuda_uint128_decimal.h"
+#include "cuda_uint128_index.h"
+#include "cuda_uint128_io.h"
+#include "cuda_uint128_ntt.h"
+#include "cuda_uint128_overflow.h"
+#include "cuda_uint128_parallel.h"
+#include "cuda_uint128_sieve.h"
 
 #if (defined __GNUC__ || defined __clang__) && defined __SIZEOF_INT128__
 #define HAS_NATIVE_UINT128_T 1
@@ -12,52 +22,53 @@
 
 using uint128_t = uint128_t;
 
-static void Test(std::uint64_t x) {
+// Named so they are not hidden by testing::Test inside the TEST bodies
+static void TestSmall(std::uint64_t x) {
   uint128_t n{x};
-  EXPECT_EQ(x, static_cast<std::uint64_t>(n));
-  EXPECT_EQ(~x, static_cast<std::uint64_t>(~n));
-  EXPECT_EQ(-x, static_cast<std::uint64_t>(-n));
-  EXPECT_EQ(!x, static_cast<std::uint64_t>(!n));
+  EXPECT_EQ(x, n.lo);
+  EXPECT_EQ(0u, n.hi);
+  EXPECT_EQ(~x, (~n).lo);
+  EXPECT_EQ(-x, (uint128_t() - n).lo);
   EXPECT_TRUE(n == n);
-  EXPECT_TRUE(n + n == n * static_cast<uint128_t>(2));
-  EXPECT_TRUE(n - n == static_cast<uint128_t>(0));
-  EXPECT_TRUE(n + n == n << static_cast<uint128_t>(1));
-  EXPECT_TRUE(n + n == n << static_cast<uint128_t>(1));
+  EXPECT_TRUE(n + n == n * 2);
+  EXPECT_TRUE(n - n == 0);
+  EXPECT_TRUE(n + n == n << 1);
   EXPECT_TRUE((n + n) - n == n);
-  EXPECT_TRUE(((n + n) >> static_cast<uint128_t>(1)) == n);
+  EXPECT_TRUE(((n + n) >> 1) == n);
   if (x != 0) {
-    EXPECT_TRUE(static_cast<uint128_t>(0) / n == static_cast<uint128_t>(0));
-    EXPECT_TRUE(static_cast<uint128_t>(n - 1) / n == static_cast<uint128_t>(0));
-    EXPECT_TRUE(static_cast<uint128_t>(n) / n == static_cast<uint128_t>(1));
-    EXPECT_TRUE(static_cast<uint128_t>(n + n - 1) / n == static_cast<uint128_t>(1));
-    EXPECT_TRUE(static_cast<uint128_t>(n + n) / n == static_cast<uint128_t>(2));
+    EXPECT_EQ(0u, uint128_t() / x);
+    EXPECT_EQ(0u, (n - 1) / x);
+    EXPECT_EQ(1u, n / x);
+    EXPECT_EQ(1u, (n + n - 1) / x);
+    EXPECT_EQ(2u, (n + n) / x);
   }
 }
 
-static void Test(std::uint64_t x, std::uint64_t y) {
+static void TestSmall(std::uint64_t x, std::uint64_t y) {
   uint128_t m{x}, n{y};
-  EXPECT_EQ(x, static_cast<std::uint64_t>(m));
-  EXPECT_EQ(y, static_cast<std::uint64_t>(n));
-  EXPECT_EQ(x & y, static_cast<std::uint64_t>(m & n));
-  EXPECT_EQ(x | y, static_cast<std::uint64_t>(m | n));
-  EXPECT_EQ(x ^ y, static_cast<std::uint64_t>(m ^ n));
-  EXPECT_EQ(x + y, static_cast<std::uint64_t>(m + n));
-  EXPECT_EQ(x - y, static_cast<std::uint64_t>(m - n));
-  EXPECT_EQ(x * y, static_cast<std::uint64_t>(m * n));
+  EXPECT_EQ(x, m.lo);
+  EXPECT_EQ(y, n.lo);
+  EXPECT_EQ(x & y, (m & n).lo);
+  EXPECT_EQ(x | y, (m | n).lo);
+  EXPECT_EQ(x ^ y, (m ^ n).lo);
+  EXPECT_EQ(x + y, (m + n).lo);
+  EXPECT_EQ(x - y, (m - n).lo);
+  EXPECT_EQ(x * y, (m * y).lo);
   if (n != 0) {
-    EXPECT_EQ(x / y, static_cast<std::uint64_t>(m / n));
+    EXPECT_EQ(x / y, m / y);
   }
 }
 
 #if HAS_NATIVE_UINT128_T
 static __uint128_t ToNative(uint128_t n) {
-  return static_cast<__uint128_t>(static_cast<std::uint64_t>(n >> 64)) << 64 |
-      static_cast<std::uint64_t>(n);
+  return static_cast<__uint128_t>(n.hi) << 64 | n.lo;
 }
 
 static uint128_t FromNative(__uint128_t n) {
-  return uint128_t{static_cast<std::uint64_t>(n >> 64)} << 64 |
-      uint128_t{static_cast<std::uint64_t>(n)};
+  uint128_t res;
+  res.lo = static_cast<std::uint64_t>(n);
+  res.hi = static_cast<std::uint64_t>(n >> 64);
+  return res;
 }
 
 static void TestVsNative(__uint128_t x, __uint128_t y) {
@@ -65,28 +76,28 @@ static void TestVsNative(__uint128_t x, __uint128_t y) {
   EXPECT_TRUE(ToNative(m) == x);
   EXPECT_TRUE(ToNative(n) == y);
   EXPECT_TRUE(ToNative(~m) == ~x);
-  EXPECT_TRUE(ToNative(-m) == -x);
-  EXPECT_TRUE(ToNative(!m) == !x);
-  EXPECT_TRUE(ToNative(m < n) == (x < y));
-  EXPECT_TRUE(ToNative(m <= n) == (x <= y));
-  EXPECT_TRUE(ToNative(m == n) == (x == y));
-  EXPECT_TRUE(ToNative(m != n) == (x != y));
-  EXPECT_TRUE(ToNative(m >= n) == (x >= y));
-  EXPECT_TRUE(ToNative(m > n) == (x > y));
+  EXPECT_TRUE(ToNative(uint128_t() - m) == -x);
+  EXPECT_EQ(m < n, x < y);
+  EXPECT_EQ(m <= n, x <= y);
+  EXPECT_EQ(m == n, x == y);
+  EXPECT_EQ(m != n, x != y);
+  EXPECT_EQ(m >= n, x >= y);
+  EXPECT_EQ(m > n, x > y);
   EXPECT_TRUE(ToNative(m & n) == (x & y));
   EXPECT_TRUE(ToNative(m | n) == (x | y));
   EXPECT_TRUE(ToNative(m ^ n) == (x ^ y));
   if (y < 128) {
-    EXPECT_TRUE(ToNative(m << n) == (x << y));
-    EXPECT_TRUE(ToNative(m >> n) == (x >> y));
+    EXPECT_TRUE(ToNative(m << static_cast<int>(y)) == (x << y));
+    EXPECT_TRUE(ToNative(m >> static_cast<int>(y)) == (x >> y));
   }
   EXPECT_TRUE(ToNative(m + n) == (x + y));
   EXPECT_TRUE(ToNative(m - n) == (x - y));
-  EXPECT_TRUE(ToNative(m * n) == (x * y));
+  EXPECT_TRUE(ToNative(mul128(m, n)) == (x * y));
   if (y > 0) {
-    EXPECT_TRUE(ToNative(m / n) == (x / y));
-    EXPECT_TRUE(ToNative(m % n) == (x % y));
-    EXPECT_TRUE(ToNative(m - n * (m / n)) == (x % y));
+    uint128_t r, q = div128to128(m, n, &r);
+    EXPECT_TRUE(ToNative(q) == (x / y));
+    EXPECT_TRUE(ToNative(r) == (x % y));
+    EXPECT_TRUE(ToNative(m - mul128(n, q)) == (x % y));
   }
 }
 
@@ -106,8 +117,8 @@ static void TestVsNative() {
       TestVsNative(m ^ ~n, m ^ n);
       TestVsNative(m ^ n, ~m ^ n);
       TestVsNative(m ^ ~n, ~m ^ n);
-      Test(m, 10000000000000000); // important case for decimal conversion
-      Test(~m, 10000000000000000);
+      TestVsNative(m, 10000000000000000); // important case for decimal conversion
+      TestVsNative(~m, 10000000000000000);
     }
   }
 }
@@ -115,11 +126,11 @@ static void TestVsNative() {
 
 TEST(uint128, Test1) {
   for (std::uint64_t j{0}; j < 64; ++j) {
-    Test(j);
-    Test(~j);
-    Test(std::uint64_t(1) << j);
+    TestSmall(j);
+    TestSmall(~j);
+    TestSmall(std::uint64_t(1) << j);
     for (std::uint64_t k{0}; k < 64; ++k) {
-      Test(j, k);
+      TestSmall(j, k);
     }
   }
 #if HAS_NATIVE_UINT128_T
@@ -144,6 +155,830 @@ TEST(uint128, Test2) {
   }
 }
 
+TEST(uint128, Sieve) {
+  EXPECT_EQ(0, uint128_t::popcount64(0));
+  EXPECT_EQ(64, uint128_t::popcount64(~(uint64_t) 0));
+  EXPECT_EQ(32, uint128_t::popcount64(0xaaaaaaaaaaaaaaaaull));
+
+  const uint32_t bound = 1000;
+  uint128_sieve sieve(bound, 64);
+  uint128_t start = ((uint128_t) 1 << 100) + 12345;
+  uint64_t length = 100000;
+
+  std::vector<uint64_t> got;
+  sieve.run(start, length, [&](uint128_t n) {
+    #pragma omp critical
+    got.push_back((n - start).lo);
+  });
+  std::sort(got.begin(), got.end());
+
+  std::vector<uint64_t> want;
+  for (uint64_t i = 0; i < length; i++) {
+    uint128_t n = start + i;
+    bool survivor = true;
+    for (uint64_t p = 2; p <= bound && survivor; p++) {
+      uint64_t r;
+      uint128_t::div128to128(n, p, &r);
+      if (r == 0) survivor = false;
+    }
+    if (survivor) want.push_back(i);
+  }
+  EXPECT_EQ(want, got);
+  EXPECT_EQ(want.size(), sieve.count(start, length));
+  EXPECT_EQ(0u, sieve.count(start, 0));
+}
+
+#if HAS_NATIVE_UINT128_T
+static __uint128_t MulModNative(__uint128_t x, __uint128_t y, __uint128_t m) {
+  __uint128_t r = 0;
+  for (; y != 0; y >>= 1) {
+    if (y & 1) r = r >= m - x ? r - (m - x) : r + x;
+    x = x >= m - x ? x - (m - x) : x + x;
+  }
+  return r;
+}
+
+TEST(uint128, Gcd) {
+  __uint128_t m{0x9e3779b97f4a7c15}, n{0xc2b2ae3d27d4eb4f};
+  for (int i = 0; i < 20000; i++) {
+    m = m * 0xd6e8feb86659fd93 + 0x2545f4914f6cdd1d;
+    n = n * 0x9e3779b97f4a7c15 + 0x6a09e667f3bcc909;
+    __uint128_t a = m >> (i % 128), b = n >> ((i / 128) % 128);
+    if (i % 7 == 0) a *= 12, b *= 18;
+    if (i % 11 == 0) b = a;
+
+    __uint128_t g = a, h = b;
+    while (h != 0) { __uint128_t t = g % h; g = h; h = t; }
+
+    EXPECT_TRUE(ToNative(gcd128(FromNative(a), FromNative(b))) == g);
+
+    uint128_t x, y;
+    bool x_negative;
+    EXPECT_TRUE(ToNative(egcd128(FromNative(a), FromNative(b), &x, &y, &x_negative)) == g);
+    __uint128_t xa = ToNative(x) * a, yb = ToNative(y) * b;
+    EXPECT_TRUE((x_negative ? yb - xa : xa - yb) == g);
+
+    if (g != 0) {
+      EXPECT_TRUE(ToNative(lcm128(FromNative(a), FromNative(b))) == a / g * b);
+      EXPECT_TRUE(ToNative(x) <= std::max<__uint128_t>(b / g / 2, 1));
+    }
+    if (b != 0) {
+      __uint128_t q = a / b, r = a % b;
+      uint128_t nr;
+      EXPECT_TRUE(ToNative(div128to128(FromNative(a), FromNative(b), &nr)) == q);
+      EXPECT_TRUE(ToNative(nr) == r);
+    }
+
+    __uint128_t inv = ToNative(modinv128(FromNative(a), FromNative(b)));
+    if (g == 1 && b > 1)
+      EXPECT_TRUE(inv < b && MulModNative(inv, a % b, b) == 1);
+    else
+      EXPECT_TRUE(inv == 0);
+  }
+}
+#endif
+
+TEST(uint128, LogsAndPowers) {
+  EXPECT_EQ(-1, ilog2_128(0));
+  EXPECT_EQ(-1, ilog10_128(0));
+  EXPECT_EQ(1, digit_count(0));
+
+  uint128_t p = 1;
+  for (unsigned k = 0; k <= 38; k++) {
+    EXPECT_TRUE(pow10_128(k) == p);
+    EXPECT_EQ((int) k, ilog10_128(p));
+    EXPECT_EQ((int) k - 1, ilog10_128(p - 1));
+    EXPECT_EQ((int) u128_to_string(p).size(), digit_count(p));
+
+    bool overflow = true;
+    EXPECT_TRUE(ipow128(10, k, &overflow) == p);
+    EXPECT_FALSE(overflow);
+    if (k < 38) p = mul128(p, 10);
+  }
+  EXPECT_EQ(38, ilog10_128(~(uint128_t) 0));
+
+  for (int j = 0; j < 128; j++)
+    EXPECT_EQ(j, ilog2_128((uint128_t) 1 << j));
+
+  bool overflow = false;
+  ipow128(10, 39, &overflow);
+  EXPECT_TRUE(overflow);
+  EXPECT_TRUE(ipow128(2, 127, &overflow) == (uint128_t) 1 << 127);
+  EXPECT_FALSE(overflow);
+  ipow128(2, 128, &overflow);
+  EXPECT_TRUE(overflow);
+  EXPECT_TRUE(ipow128(3, 80, &overflow) == mul128(ipow128(3, 40), ipow128(3, 40)));
+  EXPECT_FALSE(overflow);
+}
+
+#if HAS_NATIVE_UINT128_T
+TEST(uint128, DotProducts) {
+  std::vector<std::uint64_t> x(1003), y(1003);
+  std::uint64_t seed = 0x9e3779b97f4a7c15;
+  for (size_t i = 0; i < x.size(); i++) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    x[i] = seed;
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    y[i] = i % 5 == 0 ? ~std::uint64_t(0) : seed;
+  }
+
+  __uint128_t z = ~(__uint128_t) 0 - 12345;
+  for (size_t i = 0; i < 64; i++) {
+    __uint128_t want = (__uint128_t) x[i] * y[i] + z;
+    EXPECT_TRUE(ToNative(fma128(x[i], y[i], FromNative(z))) == want);
+    z = want;
+  }
+
+  for (size_t n : {0, 1, 3, 4, 7, 1003}) {
+    __uint128_t want = 0;
+    for (size_t i = 0; i < n; i++) want += (__uint128_t) x[i] * y[i];
+    EXPECT_TRUE(ToNative(dot_u64_to_u128(x.data(), y.data(), n)) == want);
+  }
+
+  __uint128_t want = 0;
+  for (size_t i = 0; i < 333; i++) want += (__uint128_t) x[3 * i] * y[2 * i];
+  EXPECT_TRUE(ToNative(dot_u64_to_u128_strided(x.data(), 3, y.data(), 2, 333)) == want);
+
+  uint128_t out[10];
+  gemv_u64_to_u128(x.data(), 10, 90, 100, y.data(), out);
+  for (size_t i = 0; i < 10; i++) {
+    want = 0;
+    for (size_t j = 0; j < 90; j++) want += (__uint128_t) x[i * 100 + j] * y[j];
+    EXPECT_TRUE(ToNative(out[i]) == want);
+  }
+}
+#endif
+
+TEST(uint128, StaticIndex) {
+  std::vector<uint128_t> keys;
+  std::uint64_t seed = 42;
+  for (int i = 0; i < 5000; i++) {
+    seed = seed * 6364136223846793005 + 1442695040888963407;
+    uint128_t k = (uint128_t) (seed >> 60) << 64 | (uint128_t) (seed & 0xffff);
+    keys.push_back(k);
+    if (i % 10 == 0) keys.push_back(k); // duplicates
+  }
+  std::sort(keys.begin(), keys.end());
+
+  for (size_t n : std::vector<size_t>{0, 1, 2, 3, 7, 8, 100, keys.size()}) {
+    std::vector<uint128_t> sorted(keys.begin(), keys.begin() + n);
+    u128_static_index index(sorted);
+    std::vector<uint128_t> queries;
+    for (int i = 0; i < 2000; i++) {
+      seed = seed * 6364136223846793005 + 1442695040888963407;
+      queries.push_back((uint128_t) (seed >> 60) << 64 | (uint128_t) (seed & 0xffff));
+    }
+    queries.push_back(0);
+    queries.push_back(~(uint128_t) 0);
+
+    std::vector<size_t> batch(queries.size());
+    index.lower_bound_batch(queries.data(), queries.size(), batch.data());
+    for (size_t i = 0; i < queries.size(); i++) {
+      size_t want = std::lower_bound(sorted.begin(), sorted.end(), queries[i]) - sorted.begin();
+      EXPECT_EQ(want, index.lower_bound(queries[i]));
+      EXPECT_EQ(want, batch[i]);
+      EXPECT_EQ(std::binary_search(sorted.begin(), sorted.end(), queries[i]),
+                index.contains(queries[i]));
+    }
+    for (size_t i = 0; i < n; i++)
+      EXPECT_TRUE(index.key_at(i) == sorted[i]);
+  }
+}
+
+#if HAS_NATIVE_UINT128_T
+TEST(uint128, Compare) {
+  __uint128_t values[] = {0, 1, ~(std::uint64_t) 0, (__uint128_t) 1 << 64,
+                          ((__uint128_t) 1 << 64) + 1, ~(__uint128_t) 0, ~(__uint128_t) 0 - 1};
+  for (__uint128_t x : values) {
+    for (__uint128_t y : values) {
+      EXPECT_EQ((x > y) - (x < y), compare128(FromNative(x), FromNative(y)));
+#ifdef CUDA_UINT128_HAS_SPACESHIP
+      EXPECT_TRUE((FromNative(x) <=> FromNative(y)) == (x <=> y));
+#endif
+    }
+  }
+}
+#endif
+
+#if HAS_NATIVE_UINT128_T
+template <unsigned Scale>
+static void TestDecimalVsNative(__uint128_t x, __uint128_t y) {
+  typedef decimal128<Scale> dec;
+  const __uint128_t unit = ToNative(pow10_128(Scale));
+  dec a = dec::from_raw(FromNative(x)), b = dec::from_raw(FromNative(y));
+
+  EXPECT_TRUE(ToNative(a.integer_part()) == x / unit);
+  EXPECT_TRUE(a.fraction_part() == x % unit);
+
+  bool overflow = true;
+  if (y == 0 || x <= ~(__uint128_t) 0 / y) {
+    __uint128_t p = x * y, q = p / unit, r = p % unit;
+    EXPECT_TRUE(ToNative(dec::mul(a, b, round_down, &overflow).raw) == q);
+    EXPECT_FALSE(overflow);
+    EXPECT_TRUE(ToNative(dec::mul(a, b, round_up).raw) == q + (r != 0));
+    EXPECT_TRUE(ToNative(dec::mul(a, b, round_half_up).raw) == q + (2 * r >= unit));
+    EXPECT_TRUE(ToNative(dec::mul(a, b, round_half_even).raw) ==
+                q + (2 * r > unit || (2 * r == unit && (q & 1))));
+  }
+  if (y != 0 && x <= ~(__uint128_t) 0 / unit) {
+    __uint128_t n = x * unit, q = n / y, r = n % y;
+    EXPECT_TRUE(ToNative(dec::div(a, b, round_down, &overflow).raw) == q);
+    EXPECT_FALSE(overflow);
+    EXPECT_TRUE(ToNative(dec::div(a, b, round_up).raw) == q + (r != 0));
+    EXPECT_TRUE(ToNative(dec::div(a, b, round_half_up).raw) == q + (r >= y - r));
+  }
+}
+
+template <unsigned Scale>
+static void TestDecimal() {
+  typedef decimal128<Scale> dec;
+  __uint128_t x = 0x243f6a8885a308d3, y = 0x13198a2e03707344;
+  for (int i = 0; i < 2000; i++) {
+    x = x * 0xd6e8feb86659fd93 + 0x2545f4914f6cdd1d;
+    y = y * 0x9e3779b97f4a7c15 + 0x6a09e667f3bcc909;
+    TestDecimalVsNative<Scale>(x >> (i % 128), y >> ((i / 16) % 128));
+  }
+
+  // wide products and quotients: (a * k) / k == a
+  for (int i = 0; i < 200; i++) {
+    x = x * 0xd6e8feb86659fd93 + 0x2545f4914f6cdd1d;
+    dec a = dec::from_raw(FromNative(x >> 10));
+    dec k = dec::from_integer((std::uint64_t) (x >> 118) + 1);
+    bool overflow = true;
+    dec p = dec::mul(a, k, round_down, &overflow);
+    EXPECT_FALSE(overflow);
+    EXPECT_TRUE(dec::div(p, k, round_down, &overflow) == a);
+    EXPECT_FALSE(overflow);
+  }
+
+  bool overflow = false;
+  dec big = dec::from_raw(~(uint128_t) 0);
+  dec::add(big, dec::from_raw(1), &overflow);
+  EXPECT_TRUE(overflow);
+  dec::sub(dec(), dec::from_raw(1), &overflow);
+  EXPECT_TRUE(overflow);
+  dec::mul(big, dec::from_integer(2), round_down, &overflow);
+  EXPECT_TRUE(overflow);
+  dec::div(big, dec(), round_down, &overflow);
+  EXPECT_TRUE(overflow);
+}
+
+TEST(uint128, Decimal) {
+  TestDecimal<0>();
+  TestDecimal<1>();
+  TestDecimal<6>();
+  TestDecimal<18>();
+  TestDecimal<19>();
+
+  typedef decimal128<4> dec4;
+  EXPECT_EQ("123.4567", dec4::from_string("123.4567").to_string());
+  EXPECT_EQ("0.0500", dec4::from_string(".05").to_string());
+  EXPECT_EQ("7.0000", dec4::from_string("7").to_string());
+  EXPECT_EQ("1.0000", dec4::from_string("0.99995").to_string());
+  EXPECT_EQ("0.9999", dec4::from_string("0.99995", round_down).to_string());
+  EXPECT_EQ("0.1235", dec4::from_string("0.12345", round_half_up).to_string());
+  EXPECT_EQ("0.1234", dec4::from_string("0.12345", round_half_even).to_string());
+  EXPECT_EQ("0.1235", dec4::from_string("0.123450001", round_half_even).to_string());
+  EXPECT_EQ("2", decimal128<0>::from_string("2.5").to_string());
+  EXPECT_EQ("1.0000", dec4::from_string("1e5").to_string());
+  EXPECT_EQ("12.0000", dec4::from_string("12x.5").to_string());
+  EXPECT_EQ("0.0000", dec4::from_string(" 1.5").to_string());
+
+  dec4 x = dec4::from_string("1.2500");
+  EXPECT_EQ("1.2", x.rescale<1>(round_half_even).to_string());
+  EXPECT_EQ("1.3", x.rescale<1>(round_half_up).to_string());
+  EXPECT_EQ("1.250000", x.rescale<6>().to_string());
+  EXPECT_EQ("3.7500", (x * dec4::from_integer(3)).to_string());
+  EXPECT_EQ("0.4167", (x / dec4::from_integer(3)).to_string());
+
+  bool overflow = false;
+  decimal128<0>::from_string("340282366920938463463374607431768211457", round_down, &overflow);
+  EXPECT_TRUE(overflow);
+  EXPECT_EQ("340282366920938463463374607431768211455",
+            decimal128<0>::from_string("340282366920938463463374607431768211455", round_down, &overflow).to_string());
+  EXPECT_FALSE(overflow);
+  decimal128<19>::from_raw(~(uint128_t) 0).rescale<0>(round_down, &overflow);
+  EXPECT_FALSE(overflow);
+  decimal128<0>::from_raw((uint128_t) 1 << 80).rescale<19>(round_down, &overflow);
+  EXPECT_TRUE(overflow);
+}
+#endif
+
+#ifdef CUDA_UINT128_INSTRUMENT
+TEST(uint128, Stats) {
+  uint128_stats::reset();
+  uint128_t x = (uint128_t) 1 << 100;
+  uint64_t r;
+  div128to64(x, 3, &r);                    // overflows
+  uint128_t::div128to128(x, 3, &r);
+  _icbrt(x);
+
+  uint128_stats::counters c = uint128_stats::snapshot();
+  EXPECT_EQ(1u, c[uint128_stats::div128to64_overflow]);
+  EXPECT_EQ(1u, c[uint128_stats::icbrt_calls]);
+  EXPECT_EQ(47u, c[uint128_stats::icbrt_iterations]);
+  EXPECT_LE(2u + 47u, c[uint128_stats::div128to64_calls]);
+
+  std::uint64_t calls = c[uint128_stats::div128to64_calls];
+  #pragma omp parallel for
+  for (int i = 1; i <= 1000; i++) {
+    uint64_t rem;
+    uint128_t::div128to128(x, i, &rem);
+  }
+  c = uint128_stats::snapshot();
+  EXPECT_EQ(calls + 1000, c[uint128_stats::div128to64_calls]);
+
+  uint128_stats::reset();
+  EXPECT_EQ(0u, uint128_stats::snapshot()[uint128_stats::div128to64_calls]);
+}
+#endif
+
+TEST(uint128, ParallelFor) {
+  uint128_t begin = ((uint128_t) 1 << 64) - 1000, end = ((uint128_t) 1 << 64) + 1001;
+
+  for (std::uint64_t step : {1, 3, 1000, 5000}) {
+    std::uint64_t count = 0;
+    uint128_t sum = 0;
+    parallel_for_u128(begin, end, step, [&](uint128_t base, std::uint64_t offset) {
+      uint128_t v = base + offset;
+      #pragma omp critical
+      {
+        count++;
+        sum += v;
+        EXPECT_TRUE(v >= begin && v < end);
+        EXPECT_EQ(0u, (v - begin).lo % step);
+      }
+    });
+
+    uint128_t want = 0;
+    std::uint64_t want_count = 0;
+    for (uint128_t v = begin; v < end; v = v + step) {
+      want += v;
+      want_count++;
+    }
+    EXPECT_EQ(want_count, count);
+    EXPECT_TRUE(want == sum);
+  }
+
+  // a range far wider than 2^64, where each chunk can only hold one item
+  std::uint64_t count = 0;
+  uint128_t sum = 0;
+  parallel_for_u128(0, (uint128_t) 1 << 80, (std::uint64_t) 1 << 63,
+                    [&](uint128_t base, std::uint64_t offset) {
+    #pragma omp critical
+    {
+      count++;
+      sum += base + offset;
+    }
+  });
+  EXPECT_EQ((std::uint64_t) 1 << 17, count);
+  // 2^63 * (0 + 1 + ... + (2^17 - 1))
+  EXPECT_TRUE(sum == mul128((uint128_t) 1 << 63, ((std::uint64_t) 1 << 16) * (((std::uint64_t) 1 << 17) - 1)));
+
+  uint128_counting_iterator first(begin), last(end);
+  EXPECT_EQ(2001, last - first);
+  EXPECT_TRUE(*(first + 1000) == ((uint128_t) 1 << 64));
+  EXPECT_TRUE(first[1500] == *(last - 501));
+  EXPECT_TRUE(*std::lower_bound(first, last, (uint128_t) 1 << 64) == ((uint128_t) 1 << 64));
+  EXPECT_EQ(1001, std::count_if(first, last, [](uint128_t v) { return v.hi != 0; }));
+}
+
+TEST(uint128, BulkIo) {
+  const uint128_t max = ~(uint128_t) 0;
+  uint128_t values[] = {0, 1, 9, 10, (uint128_t) 1 << 64, ((uint128_t) 1 << 64) - 1,
+                        pow10_128(19), pow10_128(38), pow10_128(38) - 1, max,
+                        uint128_t::mul128(0x0123456789abcdefull, 0xfedcba9876543210ull)};
+  const size_t n = sizeof(values) / sizeof(values[0]);
+  char buf[40];
+
+  for (int hex = 0; hex < 2; hex++) {
+    for (size_t i = 0; i < n; i++) {
+      size_t len = u128_format(values[i], buf, hex);
+      uint128_t back;
+      EXPECT_EQ(buf + len, u128_parse(buf, buf + len, &back, hex));
+      EXPECT_TRUE(back == values[i]);
+    }
+  }
+  EXPECT_EQ(39u, u128_format(max, buf));
+  EXPECT_EQ(0, std::memcmp(buf, "340282366920938463463374607431768211455", 39));
+  EXPECT_EQ(32u, u128_format(max, buf, true));
+  uint128_t back_max;
+
+  // values just past the top overflow, however they are split into words
+  bool overflow;
+  const char * too_big[] = {"340282366920938463463374607431768211456", "3402823669209384634633746074317682114550",
+                            "100000000000000000000000000000000000000000", "100000000000000000000000000000000"};
+  for (int i = 0; i < 4; i++) {
+    uint128_t v;
+    u128_parse(too_big[i], too_big[i] + std::strlen(too_big[i]), &v, i == 3, &overflow);
+    EXPECT_TRUE(overflow);
+  }
+  u128_parse(buf, buf + 32, &back_max, true, &overflow);
+  EXPECT_FALSE(overflow);
+  EXPECT_TRUE(back_max == max);
+
+  // blank lines and CRLF line ends are skipped, the last line needs no newline
+  const char text[] = "12\r\n\n340282366920938463463374607431768211455\n\n0\n18446744073709551616";
+  std::vector<uint128_t> parsed;
+  size_t bad_line = 0;
+  ASSERT_TRUE(u128_parse_lines(text, sizeof(text) - 1, &parsed));
+  ASSERT_EQ(4u, parsed.size());
+  EXPECT_TRUE(parsed[0] == 12);
+  EXPECT_TRUE(parsed[1] == max);
+  EXPECT_TRUE(parsed[3] == ((uint128_t) 1 << 64));
+  const char hex_text[] = "0x1f\r\nFF\n0X10";
+  ASSERT_TRUE(u128_parse_lines(hex_text, sizeof(hex_text) - 1, &parsed, true));
+  ASSERT_EQ(3u, parsed.size());
+  EXPECT_TRUE(parsed[0] == 31 && parsed[1] == 255 && parsed[2] == 16);
+
+  // anything but exactly one value on a line is rejected, with its line number
+  const char * bad_dec[] = {" 12", "12 ", "12abc", "0x10", "-1", "+1",
+                            "340282366920938463463374607431768211456",
+                            "123456789012345678901234567890123456789012"};
+  for (const char * b : bad_dec) {
+    std::string t = std::string("1\n\n2\r\n") + b + "\n3\n";
+    EXPECT_FALSE(u128_parse_lines(t.data(), t.size(), &parsed, false, &bad_line)) << b;
+    EXPECT_EQ(4u, bad_line) << b;
+    EXPECT_TRUE(parsed.empty());
+  }
+  const char * bad_hex[] = {"0x", "1g", "0x1_0", "100000000000000000000000000000000"};
+  for (const char * b : bad_hex) {
+    std::string t = std::string(b) + "\n";
+    EXPECT_FALSE(u128_parse_lines(t.data(), t.size(), &parsed, true, &bad_line)) << b;
+    EXPECT_EQ(1u, bad_line) << b;
+  }
+
+  // enough values to be split across threads
+  std::vector<uint128_t> big(200000);
+  for (size_t i = 0; i < big.size(); i++)
+    big[i] = uint128_t::mul128(i * 0x9e3779b97f4a7c15ull, i + 1) ^ i;
+  const std::string path = "u128_bulk_io_test.txt";
+  for (int hex = 0; hex < 2; hex++) {
+    std::vector<uint128_t> back;
+    u128_io_stats stats;
+    ASSERT_TRUE(u128_write_text(path, big.data(), big.size(), hex, &stats));
+    EXPECT_EQ(big.size(), stats.values);
+    ASSERT_TRUE(u128_read_text(path, &back, hex));
+    ASSERT_EQ(big.size(), back.size());
+    EXPECT_TRUE(std::equal(big.begin(), big.end(), back.begin()));
+  }
+  {
+    std::vector<uint128_t> back;
+    ASSERT_TRUE(u128_write_binary(path, big.data(), big.size()));
+    ASSERT_TRUE(u128_read_binary(path, &back));
+    EXPECT_TRUE(std::equal(big.begin(), big.end(), back.begin()));
+  }
+  {
+    // a bad last line is found after the file has been split across threads
+    ASSERT_TRUE(u128_write_text(path, big.data(), big.size()));
+    FILE * f = fopen(path.c_str(), "ab");
+    ASSERT_TRUE(f != NULL);
+    fputs("12x\n", f);
+    fclose(f);
+    std::vector<uint128_t> back;
+    EXPECT_FALSE(u128_read_text(path, &back, false, NULL, &bad_line));
+    EXPECT_EQ(big.size() + 1, bad_line);
+  }
+  std::remove(path.c_str());
+  std::vector<uint128_t> none;
+  bad_line = 1;
+  EXPECT_FALSE(u128_read_text(path, &none, false, NULL, &bad_line));
+  EXPECT_EQ(0u, bad_line);
+}
+
+TEST(uint128, Compress) {
+  const uint128_t max = ~(uint128_t) 0;
+  uint128_t edges[] = {0, 1, 127, 128, 16383, 16384, ((uint128_t) 1 << 63), ((uint128_t) 1 << 64) - 1,
+                       (uint128_t) 1 << 64, ((uint128_t) 1 << 126) - 1, (uint128_t) 1 << 126, max};
+  const size_t ne = sizeof(edges) / sizeof(edges[0]);
+  std::uint8_t buf[U128_VARINT_MAX_BYTES];
+
+  for (size_t i = 0; i < ne; i++) {
+    size_t len = u128_varint_encode(edges[i], buf);
+    EXPECT_EQ(edges[i] == 0 ? 1u : (128 - clz128(edges[i]) + 6) / 7, len);
+    uint128_t back;
+    EXPECT_EQ(buf + len, u128_varint_decode(buf, buf + len, &back));
+    EXPECT_TRUE(back == edges[i]);
+    // cut short
+    EXPECT_TRUE(len == 1 || u128_varint_decode(buf, buf + len - 1, &back) == NULL);
+
+    EXPECT_TRUE(u128_zigzag_decode(u128_zigzag_encode(edges[i])) == edges[i]);
+  }
+  EXPECT_EQ(U128_VARINT_MAX_BYTES, (int) u128_varint_encode(max, buf));
+  buf[U128_VARINT_MAX_BYTES - 1] = 4;     // a bit above 2^127
+  uint128_t back;
+  EXPECT_TRUE(u128_varint_decode(buf, buf + U128_VARINT_MAX_BYTES, &back) == NULL);
+
+  EXPECT_TRUE(u128_zigzag_encode(0) == 0);
+  EXPECT_TRUE(u128_zigzag_encode(max) == 1);          // -1
+  EXPECT_TRUE(u128_zigzag_encode(1) == 2);
+  EXPECT_TRUE(u128_zigzag_encode(max - 1) == 3);      // -2
+
+  // a sorted run with a few steps down, mixed with a couple of huge values
+  std::vector<uint128_t> v(1000);
+  uint128_t x = (uint128_t) 1 << 100;
+  for (size_t i = 0; i < v.size(); i++) {
+    x += (i % 97 == 0) ? max - 5 : (uint128_t) (i % 13);
+    v[i] = x;
+  }
+  v[500] = max;
+  v[501] = 0;
+
+  std::vector<uint128_t> d(v.size()), r(v.size());
+  u128_delta_encode(v.data(), v.size(), d.data());
+  u128_delta_decode(d.data(), d.size(), r.data());
+  EXPECT_TRUE(r == v);
+  u128_zigzag_delta_encode(v.data(), v.size(), d.data());
+  u128_zigzag_delta_decode(d.data(), d.size(), r.data());
+  EXPECT_TRUE(r == v);
+
+  std::vector<std::uint8_t> bytes;
+  u128_varint_encode_array(d.data(), d.size(), &bytes);
+  EXPECT_LT(bytes.size(), 2 * d.size() + 64);
+  std::vector<uint128_t> d2(d.size());
+  EXPECT_EQ(bytes.data() + bytes.size(), u128_varint_decode_array(bytes.data(), bytes.size(), d2.data(), d2.size()));
+  EXPECT_TRUE(d2 == d);
+  EXPECT_TRUE(u128_varint_decode_array(bytes.data(), bytes.size() - 1, d2.data(), d2.size()) == NULL);
+
+  // blocks of every width class: constant, narrow, exactly 64 bits, wider
+  // than 64 and the full 128 bits, plus a short last block
+  const size_t bs = u128_packed_array::block_size;
+  std::vector<uint128_t> w(5 * bs + 77);
+  for (size_t i = 0; i < w.size(); i++) {
+    std::uint64_t h = (i + 1) * 0x9e3779b97f4a7c15ull;
+    switch (i / bs) {
+      case 0: w[i] = (uint128_t) 42 << 70; break;
+      case 1: w[i] = ((uint128_t) 1 << 90) + (h >> 47); break;
+      case 2: w[i] = i == 2 * bs ? ~(std::uint64_t) 0 : (i == 2 * bs + 1 ? 0 : h); break;
+      case 3: w[i] = uint128_t::mul128(h, i); break;
+      case 4: w[i] = i == 4 * bs ? max : uint128_t::mul128(h, h ^ i); break;
+      default: w[i] = 1000 + i; break;
+    }
+  }
+  w[4 * bs + 1] = 0;
+
+  u128_packed_array packed(w.data(), w.size());
+  ASSERT_EQ(w.size(), packed.size());
+  ASSERT_EQ(6u, packed.blocks());
+  EXPECT_EQ(0u, packed.width(0));
+  EXPECT_EQ(17u, packed.width(1));
+  EXPECT_EQ(64u, packed.width(2));
+  EXPECT_EQ(128u, packed.width(4));
+  EXPECT_LT(packed.bytes(), w.size() * sizeof(uint128_t));
+  for (size_t i = 0; i < w.size(); i++)
+    EXPECT_TRUE(packed[i] == w[i]);
+
+  std::vector<uint128_t> out(w.size());
+  packed.decode(out.data());
+  EXPECT_TRUE(out == w);
+  uint128_t block[u128_packed_array::block_size];
+  EXPECT_EQ(77u, packed.decode_block(5, block));
+  EXPECT_TRUE(std::equal(block, block + 77, w.begin() + 5 * bs));
+
+  EXPECT_EQ(0u, u128_packed_array(NULL, 0).blocks());
+}
+
+static std::vector<std::uint64_t> SchoolbookMultiply(const std::vector<std::uint64_t> & a,
+                                                     const std::vector<std::uint64_t> & b)
+{
+  std::vector<std::uint64_t> res(a.size() + b.size(), 0);
+  for (size_t i = 0; i < a.size(); i++) {
+    std::uint64_t carry = 0;
+    for (size_t j = 0; j < b.size(); j++) {
+      uint128_t t = mul128(a[i], b[j]) + res[i + j];
+      t = t + carry;
+      res[i + j] = t.lo;
+      carry = t.hi;
+    }
+    res[i + b.size()] = carry;
+  }
+  return res;
+}
+
+TEST(uint128, Ntt) {
+  // round trip through one prime field, with the scaling from pointwise()
+  ntt_prime_field f(0x3fffc00000000001ull, 11);
+  f.prepare(14);
+  for (int log_n : {0, 1, 5, 11, 12, 14}) {
+    size_t n = (size_t) 1 << log_n;
+    std::vector<std::uint64_t> a(n), one(n, 0), orig;
+    for (size_t i = 0; i < n; i++) a[i] = (i * 0x9e3779b97f4a7c15ull) % f.modulus();
+    orig = a;
+    one[0] = 1;
+    f.forward(a.data(), log_n);
+    f.forward(one.data(), log_n);
+    f.pointwise(a.data(), one.data(), n, f.scale(log_n));
+    f.inverse(a.data(), log_n);
+    EXPECT_TRUE(a == orig) << "log_n " << log_n;
+  }
+
+  // both sides of the schoolbook cutoff, unbalanced sizes, and all ones
+  // limbs, which give the largest convolution coefficients
+  std::uint64_t h = 1;
+  for (size_t na : {1, 7, 600, 2100}) {
+    for (size_t nb : {1, 513, 1500}) {
+      for (int ones = 0; ones < 2; ones++) {
+        std::vector<std::uint64_t> a(na), b(nb);
+        for (auto & x : a) x = ones ? ~(std::uint64_t) 0 : (h = h * 6364136223846793005ull + 1442695040888963407ull);
+        for (auto & x : b) x = ones ? ~(std::uint64_t) 0 : (h = h * 6364136223846793005ull + 1442695040888963407ull);
+        EXPECT_TRUE(ntt_multiply(a, b) == SchoolbookMultiply(a, b)) << na << " x " << nb << " ones " << ones;
+      }
+    }
+  }
+
+  std::vector<std::uint64_t> a(1000), b(800);
+  for (size_t i = 0; i < a.size(); i++) a[i] = i * 977 + 5;
+  for (size_t i = 0; i < b.size(); i++) b[i] = (std::uint64_t) 1 << (i % 60);
+  std::vector<uint128_t> conv(a.size() + b.size() - 1), ref(conv.size(), 0);
+  ntt_convolve(a.data(), a.size(), b.data(), b.size(), conv.data());
+  for (size_t i = 0; i < a.size(); i++)
+    for (size_t j = 0; j < b.size(); j++)
+      ref[i + j] = fma128(a[i], b[j], ref[i + j]);
+  EXPECT_TRUE(conv == ref);
+
+#ifdef __cpp_lib_span
+  std::span<const std::uint64_t> sa(a), sb(b);
+  EXPECT_TRUE(ntt_multiply(sa, sb) == SchoolbookMultiply(a, b));
+#endif
+  EXPECT_TRUE(ntt_multiply(std::vector<std::uint64_t>(), b) == std::vector<std::uint64_t>(b.size(), 0));
+}
+
+#if HAS_NATIVE_UINT128_T
+TEST(uint128, Overflow) {
+  std::vector<uint128_t> values = {0, 1, 2, 3, ~(std::uint64_t) 0, (uint128_t) 1 << 64, ((uint128_t) 1 << 64) + 1,
+                                   (uint128_t) 1 << 127, ((uint128_t) 1 << 127) - 1, ~(uint128_t) 0,
+                                   ~(uint128_t) 0 - 1, uint128_t::mul128(0x0123456789abcdefull, 0xfedcba9876543210ull)};
+  for (std::uint64_t x : {1ull, 3ull, 0xffffffffull, 0x100000000ull, 0x1234567890ull})
+    values.push_back(x);
+
+  for (uint128_t x : values) {
+    for (uint128_t y : values) {
+      unsigned __int128 nx = ToNative(x), ny = ToNative(y), nr;
+      bool of = false;
+
+      uint128_t r = add128_overflow(x, y, &of);
+      EXPECT_EQ(__builtin_add_overflow(nx, ny, &nr), of);
+      EXPECT_TRUE(ToNative(r) == nr);
+
+      of = false;
+      r = sub128_overflow(x, y, &of);
+      EXPECT_EQ(__builtin_sub_overflow(nx, ny, &nr), of);
+      EXPECT_TRUE(ToNative(r) == nr);
+
+      of = false;
+      r = mul128_overflow(x, y, &of);
+      EXPECT_EQ(__builtin_mul_overflow(nx, ny, &nr), of);
+      EXPECT_TRUE(ToNative(r) == nr);
+
+      // operator-= used to ignore y.hi
+      uint128_t z = x;
+      z -= y;
+      EXPECT_TRUE(ToNative(z) == nx - ny);
+
+      of = false;
+      uint128_t rem;
+      r = div128_overflow(x, y, &of, &rem);
+      EXPECT_EQ(ny == 0, of);
+      if (ny != 0) {
+        EXPECT_TRUE(ToNative(r) == nx / ny);
+        EXPECT_TRUE(ToNative(rem) == nx % ny);
+      }
+    }
+  }
+
+  // flags are sticky
+  bool of = true;
+  add128_overflow(1, 2, &of);
+  EXPECT_TRUE(of);
+
+  of = false;
+  std::uint64_t r;
+  EXPECT_EQ(2u, div128to64(((uint128_t) 1 << 64) + 4, 1ull << 63, &r, &of));
+  EXPECT_EQ(4u, r);
+  EXPECT_FALSE(of);
+  EXPECT_EQ((std::uint64_t) -1, div128to64((uint128_t) 5 << 64, 5, &r, &of));
+  EXPECT_TRUE(of);
+
+  const uint128_t max = ~(uint128_t) 0;
+
+  wrapping_uint128_t w = max;
+  w += 2;
+  EXPECT_TRUE(w == 1);
+  EXPECT_TRUE(wrapping_uint128_t(0) - 1 == max);
+  EXPECT_TRUE(wrapping_uint128_t(7) / 0 == 0);
+
+  saturating_uint128_t s = max - 5;
+  s += 10;
+  EXPECT_TRUE(s.value() == max);
+  EXPECT_TRUE(saturating_uint128_t(3) - 4 == 0);
+  EXPECT_TRUE(saturating_uint128_t((uint128_t) 1 << 100) * ((uint128_t) 1 << 28) == max);
+  EXPECT_TRUE(saturating_uint128_t((uint128_t) 1 << 100) * ((uint128_t) 1 << 27) == ((uint128_t) 1 << 127));
+  EXPECT_TRUE(saturating_uint128_t(9) / 0 == max);
+  EXPECT_TRUE(saturating_uint128_t(9) % 4 == 1);
+
+  checked_uint128_t a = (uint128_t) 1 << 126, b = 4;
+  checked_uint128_t c = a + a;
+  EXPECT_FALSE(c.overflowed());
+  checked_uint128_t d = a * b;          // overflows
+  EXPECT_TRUE(d.overflowed());
+  checked_uint128_t e = d - d + 1;      // and the flag follows the value
+  EXPECT_TRUE(e.overflowed());
+  EXPECT_TRUE(e == 1);
+  checked_uint128_t f = c + 1 - 2;
+  EXPECT_FALSE(f.overflowed());
+  EXPECT_TRUE(f == ((uint128_t) 1 << 127) - 1);
+  e.clear_overflow();
+  EXPECT_FALSE(e.overflowed());
+
+  // still usable wherever a uint128_t is expected
+  EXPECT_TRUE(gcd128(checked_uint128_t(12), saturating_uint128_t(18)) == 6);
+
+  trapping_uint128_t t = max - 1;
+  t += 1;
+  EXPECT_TRUE(t == max);
+  EXPECT_DEATH({ t += 1; }, "");
+}
+#endif
+
+static uint128_t ClmulBitLoop(uint64_t a, uint64_t b)
+{
+  uint128_t res = 0;
+  for (int i = 0; i < 64; i++)
+    if ((a >> i) & 1) res ^= (uint128_t) b << i;
+  return res;
+}
+
+static uint128_t Gf128Pow(uint128_t a, uint128_t e)
+{
+  uint128_t res = 1;
+  for (int i = 127; i >= 0; i--) {
+    res = gf128_mul(res, res);
+    if (((e >> i).lo & 1) != 0) res = gf128_mul(res, a);
+  }
+  return res;
+}
+
+TEST(uint128, Clmul) {
+  std::uint64_t h = 0x243f6a8885a308d3ull;
+  auto next = [&h] () { h = h * 6364136223846793005ull + 1442695040888963407ull; return h ^ (h >> 29); };
+
+  std::vector<std::uint64_t> v = {0, 1, 2, 3, 0x8000000000000000ull, ~(std::uint64_t) 0, 0x87};
+  for (int i = 0; i < 50; i++) v.push_back(next());
+  for (std::uint64_t a : v) {
+    for (std::uint64_t b : v) {
+      EXPECT_TRUE(clmul64(a, b) == ClmulBitLoop(a, b));
+      EXPECT_TRUE(clmul64_table(a, b) == ClmulBitLoop(a, b));
+    }
+  }
+
+  const uint128_t one = 1, x = 2;
+  for (int i = 0; i < 40; i++) {
+    uint128_t a = ((uint128_t) next() << 64) | next();
+    uint128_t b = ((uint128_t) next() << 64) | next();
+    uint128_t c = ((uint128_t) next() << 64) | next();
+
+    // schoolbook 256 bit product for comparison
+    uint128_t hi, lo = clmul128(a, b, &hi);
+    uint128_t mid = clmul64(a.lo, b.hi) ^ clmul64(a.hi, b.lo);
+    EXPECT_TRUE(lo == (clmul64(a.lo, b.lo) ^ (mid << 64)));
+    EXPECT_TRUE(hi == (clmul64(a.hi, b.hi) ^ (mid >> 64)));
+
+    EXPECT_TRUE(gf128_mul(a, b) == gf128_mul(b, a));
+    EXPECT_TRUE(gf128_mul(a, b ^ c) == (gf128_mul(a, b) ^ gf128_mul(a, c)));
+    EXPECT_TRUE(gf128_mul(gf128_mul(a, b), c) == gf128_mul(a, gf128_mul(b, c)));
+    EXPECT_TRUE(gf128_mul(a, one) == a);
+    // a * x is a shift, folding x^128 back in as the polynomial
+    EXPECT_TRUE(gf128_mul(a, x) == ((a << 1) ^ (uint128_t) (a.hi >> 63 ? GF128_POLY_GCM : 0)));
+  }
+  EXPECT_TRUE(gf128_mul((uint128_t) 1 << 127, x) == GF128_POLY_GCM);
+  EXPECT_TRUE(gf128_mul((uint128_t) 1 << 64, (uint128_t) 1 << 64) == GF128_POLY_GCM);
+  EXPECT_TRUE(gf128_mul((uint128_t) 1 << 64, (uint128_t) 1 << 64, 0x1b) == 0x1b);
+
+  // x^128 + x^7 + x^2 + x + 1 is irreducible, so every non-zero a has
+  // a^(2^128 - 1) == 1
+  uint128_t a = ((uint128_t) next() << 64) | next();
+  EXPECT_TRUE(gf128_mul(Gf128Pow(a, ~(uint128_t) 0 - 1), a) == one);
+
+  // the aggregated hash matches Horner's rule one block at a time, also
+  // when the input arrives in pieces that split groups
+  uint128_t key = ((uint128_t) next() << 64) | next();
+  std::vector<uint128_t> blocks(23);
+  for (auto & b : blocks) b = ((uint128_t) next() << 64) | next();
+  for (size_t n = 0; n <= blocks.size(); n++) {
+    uint128_t y = 0;
+    for (size_t i = 0; i < n; i++) y = gf128_mul(y ^ blocks[i], key);
+
+    gf128_hash whole(key), pieces(key);
+    whole.update(blocks.data(), n);
+    EXPECT_TRUE(whole.digest() == y) << n;
+    pieces.update(blocks.data(), n / 3);
+    pieces.update(blocks.data() + n / 3, n - n / 3);
+    EXPECT_TRUE(pieces.digest() == y) << n;
+    pieces.reset();
+    EXPECT_TRUE(pieces.digest() == 0);
+  }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "cuda_uint128_io.h"
+
+// Converts newline separated uint128_t values between text and binary:
+//
+//   u128tool to-bin  [--hex] input.txt output.bin
+//   u128tool to-text [--hex] input.bin output.txt
+
+static int usage()
+{
+  fprintf(stderr, "usage: u128tool to-bin  [--hex] <input.txt> <output.bin>\n"
+                  "       u128tool to-text [--hex] <input.bin> <output.txt>\n");
+  return 2;
+}
+
+static void report(const char * what, const u128_io_stats & s)
+{
+  fprintf(stderr, "%-6s %12llu values %10.1f MB %8.3f s %8.1f MB/s\n", what,
+          (unsigned long long) s.values, s.bytes / 1e6, s.seconds, s.mb_per_s());
+}
+
+int main(int argc, char ** argv)
+{
+  if(argc < 4) return usage();
+
+  std::string mode = argv[1];
+  bool hex = false;
+  int arg = 2;
+  if(std::strcmp(argv[arg], "--hex") == 0){
+    hex = true;
+    arg++;
+  }
+  if(argc - arg != 2) return usage();
+  const char * in = argv[arg], * out = argv[arg + 1];
+
+  std::vector<uint128_t> values;
+  u128_io_stats rs, ws;
+
+  if(mode == "to-bin"){
+    size_t bad_line;
+    if(!u128_read_text(in, &values, hex, &rs, &bad_line)){
+      if(bad_line != 0)
+        fprintf(stderr, "u128tool: %s:%zu: not a %s 128 bit value\n", in, bad_line, hex ? "hexadecimal" : "decimal");
+      else
+        fprintf(stderr, "u128tool: cannot read %s\n", in);
+      return 1;
+    }
+    if(!u128_write_binary(out, values.data(), values.size(), &ws)){
+      fprintf(stderr, "u128tool: cannot write %s\n", out);
+      return 1;
+    }
+  }else if(mode == "to-text"){
+    if(!u128_read_binary(in, &values, &rs)){
+      fprintf(stderr, "u128tool: cannot read %s (or its size is not a multiple of 16)\n", in);
+      return 1;
+    }
+    if(!u128_write_text(out, values.data(), values.size(), hex, &ws)){
+      fprintf(stderr, "u128tool: cannot write %s\n", out);
+      return 1;
+    }
+  }else{
+    return usage();
+  }
+
+  report("read", rs);
+  report("write", ws);
+  return 0;
+}